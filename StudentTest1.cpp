@@ -1,6 +1,29 @@
 #include "doctest.h"
 #include "sources/MagicalContainer.hpp"
+#include "sources/ParallelForEach.hpp"
+#include "sources/IngestQueue.hpp"
+#include "sources/TraversalGenerators.hpp"
+#include "sources/BitmapStore.hpp"
+#include "sources/HugePageResource.hpp"
+#include "sources/ContainerFile.hpp"
+#include "sources/MappedMagicalContainer.hpp"
+#include "sources/TextIngest.hpp"
+#include "sources/WriteAheadLog.hpp"
+#include "sources/Checkpointer.hpp"
+#include "sources/TraversalExport.hpp"
+#include "sources/RangeView.hpp"
 #include <stdexcept>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <memory_resource>
+#include <set>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <csignal>
+#include <sys/resource.h>
 
 using namespace ariel;
 using namespace std;
@@ -597,3 +620,1459 @@ TEST_CASE("operator= throws when iterators are pointing at different containers"
 }
 
 
+
+
+TEST_CASE("Parallel traversal over every mode") {
+    MagicalContainer container;
+    for (int i = 1; i <= 1000; ++i) {
+        container.addElement(i);
+    }
+    WorkStealingPool pool(4);
+
+    SUBCASE("parallelForEach visits every element once") {
+        atomic<long> sum(0);
+        atomic<size_t> visits(0);
+        parallelForEach(container, TraversalMode::SideCross, [&](int element) {
+            sum += element;
+            ++visits;
+        }, pool);
+        CHECK(visits == 1000);
+        CHECK(sum == 500500);
+    }
+
+    SUBCASE("parallelReduce keeps the traversal order") {
+        vector<int> expected;
+        MagicalContainer::SideCrossIterator it(container);
+        for (auto cur = it.begin(); cur != it.end(); ++cur) {
+            expected.push_back(*cur);
+        }
+
+        vector<int> reduced = parallelReduce(container, TraversalMode::SideCross, vector<int>(),
+            [](int element) { return vector<int>{element}; },
+            [](vector<int> left, vector<int> right) {
+                left.insert(left.end(), right.begin(), right.end());
+                return left;
+            }, pool);
+        CHECK(reduced == expected);
+
+        long primes = parallelReduce(container, TraversalMode::Prime, 0L,
+            [](int) { return 1L; }, [](long left, long right) { return left + right; }, pool);
+        CHECK(primes == 168);
+    }
+
+    SUBCASE("Exceptions thrown by the callback reach the caller") {
+        CHECK_THROWS_AS(parallelForEach(container, TraversalMode::Ascending, [](int element) {
+            if (element == 500) {
+                throw runtime_error("callback failed");
+            }
+        }, pool), runtime_error);
+    }
+
+    SUBCASE("Nested runs on the same pool execute inline") {
+        atomic<long> sum(0);
+        parallelForEach(container, TraversalMode::Prime, [&](int) {
+            sum += parallelReduce(container, TraversalMode::Ascending, 0L,
+                [](int element) { return long{element}; }, [](long left, long right) { return left + right; }, pool);
+        }, pool);
+        CHECK(sum == 168L * 500500);
+    }
+}
+
+TEST_CASE("Batched and queued ingestion") {
+    MagicalContainer container;
+    container.addElement(1);
+    container.addElement(2);
+    container.addElement(3);
+
+    SUBCASE("applyBatch rebuilds every order") {
+        container.applyBatch({10, 5, 7, 2}, {1, 100});
+        CHECK(container.size() == 5);
+
+        MagicalContainer::SideCrossIterator it(container);
+        CHECK(*it == 2);
+        ++it;
+        CHECK(*it == 10);
+        ++it;
+        CHECK(*it == 3);
+        ++it;
+        CHECK(*it == 7);
+        ++it;
+        CHECK(*it == 5);
+
+        MagicalContainer::PrimeIterator prime(container);
+        CHECK(*prime == 2);
+        ++(++(++prime));
+        CHECK(*prime == 7);
+        ++prime;
+        CHECK(prime == prime.end());
+    }
+
+    SUBCASE("A failed batch is reported by the next call") {
+        // The container can hold its elements inline but never allocate a store
+        MagicalContainer limited(StorageBackend::Indexed, pmr::null_memory_resource());
+        IngestQueue queue(limited);
+        {
+            // Holding the container keeps the applier from failing while the operations are queued
+            auto lock = queue.lock();
+            for (int i = 0; i < 40; ++i) {
+                queue.add(i);
+            }
+        }
+        CHECK_THROWS_AS(queue.flush(), bad_alloc);
+        CHECK_NOTHROW(queue.flush());
+
+        // The queue keeps working once the failure is reported
+        size_t before = limited.size();
+        REQUIRE(before > 0);
+        queue.remove(limited.at(TraversalMode::Ascending, 0));
+        queue.flush();
+        CHECK(limited.size() == before - 1);
+    }
+
+    SUBCASE("IngestQueue coalesces operations from many producers") {
+        IngestQueue queue(container);
+        vector<thread> producers;
+        for (int t = 0; t < 4; ++t) {
+            producers.emplace_back([&queue, t]() {
+                for (int i = 0; i < 250; ++i) {
+                    queue.add(t * 250 + i + 10);
+                    queue.remove(t * 250 + i + 10);
+                    queue.add(t * 250 + i + 10);
+                }
+            });
+        }
+        for (thread &producer : producers) {
+            producer.join();
+        }
+        queue.remove(1);
+        queue.remove(2);
+        queue.flush();
+
+        auto lock = queue.lock();
+        CHECK(container.size() == 1001);
+        MagicalContainer::AscendingIterator it(container);
+        CHECK(*it == 3);
+        ++it;
+        CHECK(*it == 10);
+    }
+}
+
+TEST_CASE("Snapshots keep a consistent view while the container changes") {
+    MagicalContainer container;
+    container.addElement(2);
+    container.addElement(4);
+    container.addElement(7);
+
+    MagicalContainer snapshot = container.snapshot();
+    MagicalContainer::AscendingIterator it(snapshot);
+    CHECK(*it == 2);
+
+    container.addElement(1);
+    container.addElement(3);
+    container.removeElement(7);
+
+    SUBCASE("The snapshot still holds the old contents") {
+        CHECK(snapshot.size() == 3);
+        ++it;
+        CHECK(*it == 4);
+        ++it;
+        CHECK(*it == 7);
+        ++it;
+        CHECK(it == it.end());
+
+        MagicalContainer::SideCrossIterator cross(snapshot);
+        CHECK(*cross == 2);
+        ++cross;
+        CHECK(*cross == 7);
+
+        MagicalContainer::PrimeIterator prime(snapshot);
+        CHECK(*prime == 2);
+        ++prime;
+        CHECK(*prime == 7);
+    }
+
+    SUBCASE("The container holds the new contents") {
+        CHECK(container.size() == 4);
+        MagicalContainer::PrimeIterator prime(container);
+        CHECK(*prime == 2);
+        ++prime;
+        CHECK(*prime == 3);
+        ++prime;
+        CHECK(prime == prime.end());
+    }
+
+    SUBCASE("Writing to the snapshot does not touch the container") {
+        snapshot.addElement(11);
+        CHECK(snapshot.size() == 4);
+        CHECK(container.size() == 4);
+        MagicalContainer::AscendingIterator last(container, 3);
+        CHECK(*last == 4);
+    }
+}
+
+TEST_CASE("Coroutine generators over every mode") {
+    MagicalContainer container;
+    container.addElement(1);
+    container.addElement(2);
+    container.addElement(4);
+    container.addElement(5);
+    container.addElement(14);
+
+    SUBCASE("Each mode yields its traversal order") {
+        vector<int> values;
+        for (int element : ascending(container)) {
+            values.push_back(element);
+        }
+        CHECK(values == vector<int>{1, 2, 4, 5, 14});
+
+        values.clear();
+        for (int element : sideCross(container)) {
+            values.push_back(element);
+        }
+        CHECK(values == vector<int>{1, 14, 2, 5, 4});
+
+        values.clear();
+        for (int element : primes(container)) {
+            values.push_back(element);
+        }
+        CHECK(values == vector<int>{2, 5});
+    }
+
+    SUBCASE("Filtered generator skips rejected elements") {
+        vector<int> values;
+        for (int element : filtered(container, TraversalMode::SideCross, [](int element) { return element % 2 == 0; })) {
+            values.push_back(element);
+        }
+        CHECK(values == vector<int>{14, 2, 4});
+    }
+
+    SUBCASE("Chunked generator yields spans") {
+        vector<size_t> sizes;
+        vector<int> values;
+        for (span<const int> chunk : chunked(container, TraversalMode::Ascending, 2)) {
+            sizes.push_back(chunk.size());
+            values.insert(values.end(), chunk.begin(), chunk.end());
+        }
+        CHECK(sizes == vector<size_t>{2, 2, 1});
+        CHECK(values == vector<int>{1, 2, 4, 5, 14});
+
+        auto invalid = chunked(container, TraversalMode::Ascending, 0);
+        CHECK_THROWS_AS(invalid.begin(), invalid_argument);
+    }
+
+    SUBCASE("A suspended generator does not see later changes") {
+        auto generator = ascending(container);
+        auto it = generator.begin();
+        CHECK(*it == 1);
+        container.addElement(3);
+        ++it;
+        CHECK(*it == 2);
+        ++it;
+        CHECK(*it == 4);
+    }
+}
+
+// Memory resource that counts the bytes it hands out
+class CountingResource : public pmr::memory_resource {
+public:
+    size_t allocated = 0;
+    size_t outstanding = 0;
+
+private:
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        allocated += bytes;
+        outstanding += bytes;
+        return pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *pointer, size_t bytes, size_t alignment) override {
+        outstanding -= bytes;
+        pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+TEST_CASE("Containers allocate from the given memory resource") {
+    CountingResource counting;
+
+    SUBCASE("Every structure goes through the resource") {
+        {
+            MagicalContainer container(&counting);
+            CHECK(container.resource() == &counting);
+            size_t empty = counting.allocated;
+            for (int i = 0; i < 100; ++i) {
+                container.addElement(i);
+            }
+            CHECK(counting.allocated > empty);
+
+            MagicalContainer snapshot = container.snapshot();
+            container.removeElement(50);
+            CHECK(snapshot.resource() == &counting);
+            CHECK(snapshot.size() == 100);
+            CHECK(container.size() == 99);
+        }
+        CHECK(counting.outstanding == 0);
+    }
+
+    SUBCASE("A monotonic arena backs a short-lived container") {
+        pmr::monotonic_buffer_resource arena(&counting);
+        MagicalContainer container(&arena);
+        container.applyBatch({5, 3, 2, 8, 13, 21, 34, 55, 89, 144, 233, 377, 610, 987, 1597, 2584, 4181}, {});
+        MagicalContainer::SideCrossIterator it(container);
+        CHECK(*it == 2);
+        ++it;
+        CHECK(*it == 4181);
+        CHECK(counting.allocated > 0);
+    }
+}
+
+// Collects the elements of a traversal mode
+static vector<int> traversal(const MagicalContainer &container, TraversalMode mode) {
+    vector<int> elements;
+    for (size_t index = 0; index < container.count(mode); ++index) {
+        elements.push_back(container.at(mode, index));
+    }
+    return elements;
+}
+
+// Checks that two containers traverse the same elements in every mode
+static void checkSameTraversals(const MagicalContainer &expected, const MagicalContainer &actual) {
+    for (TraversalMode mode : {TraversalMode::Ascending, TraversalMode::SideCross, TraversalMode::Prime}) {
+        CHECK(traversal(actual, mode) == traversal(expected, mode));
+    }
+}
+
+TEST_CASE("Compressed storage backend") {
+    MagicalContainer reference;
+    MagicalContainer compressed(StorageBackend::Compressed);
+    vector<int> values;
+    unsigned int seed = 12345;
+    for (int i = 0; i < 2000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        values.push_back(static_cast<int>(seed % 20000) - 5000);
+    }
+    values.push_back(2147483647);
+    values.push_back(-2147483647 - 1);
+    reference.applyBatch(values, {});
+    compressed.applyBatch(values, {});
+
+    SUBCASE("Every mode matches the indexed backend") {
+        CHECK(compressed.backend() == StorageBackend::Compressed);
+        CHECK(compressed.size() == reference.size());
+        checkSameTraversals(reference, compressed);
+    }
+
+    SUBCASE("Iterators and modifications work on compressed storage") {
+        compressed.addElement(7);
+        reference.addElement(7);
+        compressed.removeElement(values[10]);
+        reference.removeElement(values[10]);
+        CHECK_THROWS_AS(compressed.removeElement(values[10]), runtime_error);
+        checkSameTraversals(reference, compressed);
+
+        MagicalContainer::AscendingIterator it(compressed);
+        CHECK(*it == -2147483647 - 1);
+        MagicalContainer::PrimeIterator prime(compressed);
+        CHECK(*prime == reference.at(TraversalMode::Prime, 0));
+        MagicalContainer::SideCrossIterator cross(compressed);
+        ++cross;
+        CHECK(*cross == 2147483647);
+    }
+
+    SUBCASE("Bursts of single modifications are merged on the next read") {
+        // Re-adding removed values and removing fresh ones within one burst keeps the last operation
+        for (int i = 0; i < 3000; ++i) {
+            int element = i * 3 - 4000;
+            compressed.addElement(element);
+            reference.addElement(element);
+            if (i % 5 == 0) {
+                compressed.removeElement(element);
+                reference.removeElement(element);
+            }
+        }
+        for (size_t i = 0; i < 50; ++i) {
+            if (compressed.contains(values[i])) {
+                compressed.removeElement(values[i]);
+                reference.removeElement(values[i]);
+            }
+        }
+        CHECK(compressed.size() == reference.size());
+        checkSameTraversals(reference, compressed);
+    }
+
+    SUBCASE("Switching backends keeps the contents") {
+        reference.useBackend(StorageBackend::Compressed);
+        CHECK(reference.backend() == StorageBackend::Compressed);
+        checkSameTraversals(compressed, reference);
+        compressed.useBackend(StorageBackend::Indexed);
+        checkSameTraversals(reference, compressed);
+    }
+}
+
+TEST_CASE("Bitmap storage backend") {
+    MagicalContainer reference;
+    MagicalContainer bitmap(StorageBackend::Bitmap);
+    vector<int> values;
+    for (int i = 0; i < 10000; ++i) {
+        values.push_back(i);
+    }
+    for (int i = -70000; i < -60000; i += 2) {
+        values.push_back(i);
+    }
+    for (int i = 0; i < 300; ++i) {
+        values.push_back(i * 7919 + 100000);
+    }
+    values.push_back(2147483647);
+    values.push_back(-2147483647 - 1);
+    reference.applyBatch(values, {});
+    bitmap.applyBatch(values, {});
+
+    SUBCASE("Every mode matches the indexed backend") {
+        CHECK(bitmap.backend() == StorageBackend::Bitmap);
+        CHECK(bitmap.size() == reference.size());
+        checkSameTraversals(reference, bitmap);
+    }
+
+    SUBCASE("Chunks change layout as elements come and go") {
+        vector<int> removals;
+        for (int i = 0; i < 10000; i += 3) {
+            removals.push_back(i);
+        }
+        for (int i = 1; i < 7000; i += 3) {
+            removals.push_back(i);
+        }
+        reference.applyBatch({}, removals);
+        bitmap.applyBatch({}, removals);
+        checkSameTraversals(reference, bitmap);
+
+        for (int i = -70000; i < -65000; i += 2) {
+            bitmap.addElement(i + 1);
+            reference.addElement(i + 1);
+        }
+        bitmap.removeElement(-61000);
+        reference.removeElement(-61000);
+        CHECK_THROWS_AS(bitmap.removeElement(-61000), runtime_error);
+        checkSameTraversals(reference, bitmap);
+
+        MagicalContainer::SideCrossIterator cross(bitmap);
+        CHECK(*cross == -2147483647 - 1);
+        ++cross;
+        CHECK(*cross == 2147483647);
+    }
+
+    SUBCASE("Run chunks select through their prefix counts as runs join and split") {
+        // Stretches of three with gaps of one are smallest as runs, so the chunk starts in the Run layout
+        vector<int> stretches;
+        for (int i = 0; i < 1500; ++i) {
+            stretches.insert(stretches.end(), {i * 4, i * 4 + 1, i * 4 + 2});
+        }
+        MagicalContainer runs = MagicalContainer::fromSorted(stretches, StorageBackend::Bitmap);
+        MagicalContainer expected = MagicalContainer::fromSorted(stretches);
+        checkSameTraversals(expected, runs);
+
+        for (int i = 0; i < 1500; i += 7) {
+            runs.addElement(i * 4 + 3);
+            expected.addElement(i * 4 + 3);
+            runs.removeElement(i * 4 + 1);
+            expected.removeElement(i * 4 + 1);
+        }
+        runs.addElement(-5);
+        expected.addElement(-5);
+        runs.removeElement(-5);
+        expected.removeElement(-5);
+        checkSameTraversals(expected, runs);
+    }
+
+    SUBCASE("Sieved prime masks agree with the prime test") {
+        for (uint16_t high : {uint16_t{0x7FFF}, uint16_t{0x8000}, uint16_t{0x8001}, uint16_t{0xFFFF}}) {
+            vector<uint64_t> mask = BitmapStore::primeMask(high);
+            size_t mismatches = 0;
+            for (uint32_t low = 0; low < 65536; low += 7) {
+                int element = ElementStore::fromKey(static_cast<uint32_t>(high) << 16 | low);
+                bool marked = ((mask[low / 64] >> (low % 64)) & 1U) != 0;
+                mismatches += marked != ElementStore::isPrime(element) ? 1U : 0U;
+            }
+            CHECK(mismatches == 0);
+        }
+    }
+
+    SUBCASE("Switching backends keeps the contents") {
+        reference.useBackend(StorageBackend::Bitmap);
+        checkSameTraversals(bitmap, reference);
+        bitmap.useBackend(StorageBackend::Compressed);
+        checkSameTraversals(reference, bitmap);
+    }
+}
+
+TEST_CASE("Indexed positions follow single and batched modifications") {
+    MagicalContainer container;
+    for (int i = 30; i >= -10; i -= 3) {
+        container.addElement(i);
+    }
+    container.removeElement(21);
+    container.removeElement(-6);
+    container.applyBatch({2, 5, 13, 17, 40}, {30, 3, 17});
+    vector<int> expected = {-9, -3, 0, 2, 5, 6, 9, 12, 13, 15, 17, 18, 24, 27, 40};
+
+    CHECK(traversal(container, TraversalMode::Ascending) == expected);
+    CHECK(traversal(container, TraversalMode::Prime) == vector<int>{-3, 2, 5, 13, 17});
+    CHECK(traversal(container, TraversalMode::SideCross) == vector<int>{-9, 40, -3, 27, 0, 24, 2, 18, 5, 17, 6, 15, 9, 13, 12});
+}
+
+TEST_CASE("Reserving capacity ahead of a load") {
+    CountingResource counting;
+    MagicalContainer container(&counting);
+    container.reserve(1000);
+    CHECK(container.capacity() >= 1000);
+
+    size_t reserved = counting.allocated;
+    for (int batch = 0; batch < 10; ++batch) {
+        vector<int> additions;
+        for (int i = batch; i < 1000; i += 10) {
+            additions.push_back(i);
+        }
+        container.applyBatch(additions, {});
+    }
+    CHECK(counting.allocated == reserved);
+    CHECK(container.capacity() >= 1000);
+
+    vector<int> removals;
+    for (int i = 0; i < 990; ++i) {
+        removals.push_back(i);
+    }
+    container.applyBatch({}, removals);
+    CHECK(container.capacity() >= 1000);
+    container.shrinkToFit();
+    CHECK(container.capacity() == MagicalContainer::InlineCapacity);
+    CHECK(traversal(container, TraversalMode::Ascending) == vector<int>{990, 991, 992, 993, 994, 995, 996, 997, 998, 999});
+}
+
+TEST_CASE("Memory footprint per structure") {
+    MagicalContainer container;
+    for (int i = 1; i <= 100; ++i) {
+        container.addElement(i);
+    }
+
+    // The additions after the inline array spilled are still buffered, and measured as overhead
+    MemoryFootprint footprint = container.memoryFootprint();
+    CHECK(footprint.values.used == MagicalContainer::InlineCapacity * sizeof(int));
+    CHECK(footprint.overhead.used >= (100 - MagicalContainer::InlineCapacity) * (sizeof(int) + sizeof(bool)));
+    size_t buffered = footprint.overhead.used;
+
+    container.commit();
+    footprint = container.memoryFootprint();
+    CHECK(footprint.values.used == 100 * sizeof(int));
+    CHECK(footprint.overhead.used < buffered);
+    CHECK(footprint.ascending.reserved == 0);
+    CHECK(footprint.sideCross.used == 0);
+    MagicalContainer::SideCrossIterator cross(container);
+    footprint = container.memoryFootprint();
+    CHECK(footprint.sideCross.used == 100 * sizeof(uint32_t));
+    CHECK(footprint.prime.used == 25 * sizeof(uint32_t));
+    CHECK(footprint.total().reserved >= footprint.total().used);
+
+    container.reserve(10000);
+    CHECK(container.memoryFootprint().values.reserved >= 10000 * sizeof(int));
+    CHECK(container.memoryFootprint().values.used == 100 * sizeof(int));
+
+    for (StorageBackend backend : {StorageBackend::Compressed, StorageBackend::Bitmap}) {
+        container.useBackend(backend);
+        MemoryFootprint other = container.memoryFootprint();
+        CHECK(other.values.used > 0);
+        CHECK(other.prime.used > 0);
+        CHECK(other.total().used < footprint.total().used);
+    }
+}
+
+TEST_CASE("Copies, moves and swaps") {
+    MagicalContainer original;
+    for (int i = 1; i <= 10; ++i) {
+        original.addElement(i);
+    }
+
+    SUBCASE("Copies are independent") {
+        MagicalContainer copy(original);
+        MagicalContainer assigned;
+        assigned.addElement(100);
+        assigned = original;
+
+        original.removeElement(7);
+        original.addElement(11);
+        copy.addElement(13);
+        assigned.removeElement(2);
+
+        CHECK(traversal(original, TraversalMode::Prime) == vector<int>{2, 3, 5, 11});
+        CHECK(traversal(copy, TraversalMode::Prime) == vector<int>{2, 3, 5, 7, 13});
+        CHECK(traversal(assigned, TraversalMode::Prime) == vector<int>{3, 5, 7});
+        CHECK(traversal(copy, TraversalMode::SideCross) == vector<int>{1, 13, 2, 10, 3, 9, 4, 8, 5, 7, 6});
+    }
+
+    SUBCASE("Moves take the elements and leave an empty container") {
+        MagicalContainer moved(std::move(original));
+        CHECK(moved.size() == 10);
+        CHECK(original.size() == 0);
+        CHECK(original.count(TraversalMode::Prime) == 0);
+
+        original.addElement(5);
+        CHECK(traversal(original, TraversalMode::Ascending) == vector<int>{5});
+        MagicalContainer other;
+        CHECK(other.size() == 0);
+
+        original = std::move(moved);
+        CHECK(original.size() == 10);
+        CHECK(moved.size() == 0);
+    }
+
+    SUBCASE("Swap exchanges contents and iterators follow their container") {
+        MagicalContainer other;
+        other.addElement(42);
+        MagicalContainer::AscendingIterator it(other);
+
+        swap(original, other);
+        CHECK(original.size() == 1);
+        CHECK(other.size() == 10);
+        CHECK(*it == 1);
+        CHECK(it.end() == MagicalContainer::AscendingIterator(other, 10));
+    }
+
+    SUBCASE("Moving an iterator never touches its container") {
+        MagicalContainer other;
+        other.addElement(42);
+        MagicalContainer::PrimeIterator first(original);
+        MagicalContainer::PrimeIterator second(original);
+        ++second;
+        first = std::move(second);
+        CHECK(*first == 3);
+        CHECK_THROWS_AS(first = MagicalContainer::PrimeIterator(other), runtime_error);
+        CHECK(original.size() == 10);
+        CHECK(other.size() == 1);
+    }
+}
+
+TEST_CASE("Small containers keep their elements inline") {
+    CountingResource counting;
+    MagicalContainer container(&counting);
+    for (int i = 16; i >= 1; --i) {
+        container.addElement(i);
+    }
+    container.addElement(3);
+    container.removeElement(4);
+    container.addElement(-7);
+    CHECK_THROWS_AS(container.removeElement(4), runtime_error);
+    CHECK(counting.allocated == 0);
+    CHECK(container.memoryFootprint().total().reserved == 0);
+
+    vector<int> ascending = {-7, 1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    CHECK(traversal(container, TraversalMode::Ascending) == ascending);
+    CHECK(traversal(container, TraversalMode::Prime) == vector<int>{-7, 2, 3, 5, 7, 11, 13});
+    CHECK(traversal(container, TraversalMode::SideCross) == vector<int>{-7, 16, 1, 15, 2, 14, 3, 13, 5, 12, 6, 11, 7, 10, 8, 9});
+
+    MagicalContainer snapshot = container.snapshot();
+    container.addElement(17);
+    CHECK(counting.allocated > 0);
+    CHECK(snapshot.size() == 16);
+    CHECK(traversal(container, TraversalMode::Prime) == vector<int>{-7, 2, 3, 5, 7, 11, 13, 17});
+
+    container.applyBatch({}, {1, 6, 8, 9, 10, 12, 14});
+    container.shrinkToFit();
+    CHECK(counting.outstanding == 0);
+    CHECK(traversal(container, TraversalMode::Prime) == vector<int>{-7, 2, 3, 5, 7, 11, 13, 17});
+    CHECK(traversal(container, TraversalMode::SideCross) == vector<int>{-7, 17, 2, 16, 3, 15, 5, 13, 7, 11});
+}
+
+TEST_CASE("Huge-page mappings back large arrays") {
+    HugePageResource hugePages(64 * 1024);
+    {
+        MagicalContainer container(&hugePages);
+        // The side-cross index is not built yet, so it is not reserved either
+        container.reserve(100000);
+        CHECK(hugePages.mappings() == 2);
+        CHECK(hugePages.mappedBytes() % HugePageResource::HugePageSize == 0);
+
+        vector<int> values;
+        for (int i = 0; i < 100000; ++i) {
+            values.push_back(i * 3);
+        }
+        container.applyBatch(values, {});
+        container.addElement(1);
+        CHECK(container.size() == 100001);
+        CHECK(container.at(TraversalMode::Ascending, 1) == 1);
+        CHECK(container.at(TraversalMode::SideCross, 1) == 299997);
+        CHECK(container.at(TraversalMode::Prime, 0) == 3);
+    }
+    CHECK(hugePages.mappings() == 0);
+    CHECK(hugePages.mappedBytes() == 0);
+}
+
+TEST_CASE("Traversal indexes are built on first use") {
+    MagicalContainer container;
+    vector<int> values;
+    for (int i = 0; i < 1000; ++i) {
+        values.push_back(i);
+    }
+    container.applyBatch(values, {});
+    container.dropIndexes();
+    for (int i = 1000; i < 1100; ++i) {
+        container.addElement(i);
+    }
+    container.removeElement(500);
+    CHECK(container.memoryFootprint().sideCross.reserved == 0);
+    CHECK(container.memoryFootprint().prime.reserved == 0);
+
+    MagicalContainer::PrimeIterator primes(container);
+    CHECK(container.memoryFootprint().prime.used == 184 * sizeof(uint32_t));
+    CHECK(container.memoryFootprint().sideCross.used == 0);
+    container.addElement(1103);
+    container.removeElement(2);
+    CHECK(*primes == 3);
+    CHECK(container.count(TraversalMode::Prime) == 184);
+
+    SUBCASE("Readers of a shared snapshot build an index once") {
+        MagicalContainer snapshot = container.snapshot();
+        vector<thread> readers;
+        vector<int> seconds(4);
+        for (size_t t = 0; t < 4; ++t) {
+            readers.emplace_back([&snapshot, &seconds, t]() { seconds[t] = snapshot.at(TraversalMode::SideCross, 1); });
+        }
+        for (thread &reader : readers) {
+            reader.join();
+        }
+        CHECK(seconds == vector<int>(4, 1103));
+        CHECK(traversal(container, TraversalMode::SideCross).size() == 1099);
+    }
+
+    SUBCASE("Dropped indexes come back on the next read") {
+        container.dropIndexes();
+        CHECK(traversal(container, TraversalMode::Prime).back() == 1103);
+        CHECK(container.at(TraversalMode::SideCross, 1) == 1103);
+    }
+}
+
+TEST_CASE("Bursts of modifications are merged on the next read") {
+    MagicalContainer container;
+    set<int> reference;
+    for (int i = 0; i < 200; ++i) {
+        container.addElement(i * 2);
+        reference.insert(i * 2);
+    }
+    MagicalContainer::PrimeIterator primes(container);
+    MagicalContainer::SideCrossIterator cross(container);
+    CHECK(*primes == 2);
+
+    unsigned int seed = 7;
+    for (int i = 0; i < 3000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        int element = static_cast<int>(seed % 600) - 100;
+        if (reference.count(element) != 0) {
+            container.removeElement(element);
+            reference.erase(element);
+        } else {
+            container.addElement(element);
+            reference.insert(element);
+        }
+    }
+    CHECK_THROWS_AS(container.removeElement(1000), runtime_error);
+    CHECK(container.size() == reference.size());
+
+    SUBCASE("Iterators see the burst") {
+        vector<int> expected(reference.begin(), reference.end());
+        CHECK(traversal(container, TraversalMode::Ascending) == expected);
+        vector<int> expectedPrimes;
+        copy_if(expected.begin(), expected.end(), back_inserter(expectedPrimes), [](int element) {
+            return ElementStore::isPrime(element);
+        });
+        CHECK(traversal(container, TraversalMode::Prime) == expectedPrimes);
+        CHECK(*cross == expected.front());
+        CHECK(*primes == expectedPrimes.front());
+    }
+
+    SUBCASE("An explicit commit leaves nothing for the read") {
+        container.commit();
+        MagicalContainer snapshot = container.snapshot();
+        container.addElement(10007);
+        CHECK(snapshot.size() == reference.size());
+        CHECK(container.at(TraversalMode::Ascending, container.size() - 1) == 10007);
+        CHECK(container.at(TraversalMode::SideCross, 1) == 10007);
+    }
+}
+
+TEST_CASE("Saving and loading containers") {
+    string path = (filesystem::temp_directory_path() / "magical_container_test.bin").string();
+    MagicalContainer original;
+    vector<int> values = {2147483647, -2147483647 - 1, 0, -2, 2};
+    for (int i = 0; i < 5000; ++i) {
+        values.push_back(i * 37 - 90000);
+    }
+    original.applyBatch(values, {});
+    original.save(path);
+
+    SUBCASE("A loaded container matches the saved one") {
+        MagicalContainer loaded;
+        loaded.addElement(12345);
+        loaded.load(path);
+        checkSameTraversals(original, loaded);
+
+        MagicalContainer bitmap(StorageBackend::Bitmap);
+        bitmap.load(path);
+        CHECK(bitmap.backend() == StorageBackend::Bitmap);
+        checkSameTraversals(original, bitmap);
+    }
+
+    SUBCASE("Small and empty containers round trip") {
+        MagicalContainer small;
+        small.applyBatch({7, 4, 9}, {});
+        small.save(path);
+        MagicalContainer loaded;
+        loaded.load(path);
+        CHECK(traversal(loaded, TraversalMode::SideCross) == vector<int>{4, 9, 7});
+        CHECK(traversal(loaded, TraversalMode::Prime) == vector<int>{7});
+
+        MagicalContainer().save(path);
+        loaded.load(path);
+        CHECK(loaded.size() == 0);
+    }
+
+    SUBCASE("Damaged files are rejected") {
+        vector<uint8_t> bytes = ContainerFile::readFile(path);
+        CHECK(bytes.size() < values.size() * 3);
+
+        vector<uint8_t> truncated(bytes.begin(), bytes.end() - 1);
+        vector<int> sorted, primes;
+        CHECK_THROWS_AS(ContainerFile::decode(truncated, sorted, primes), runtime_error);
+
+        vector<uint8_t> future = bytes;
+        future[4] = 99;
+        CHECK_THROWS_AS(ContainerFile::decode(future, sorted, primes), runtime_error);
+
+        vector<uint8_t> garbage = bytes;
+        garbage[0] = 'X';
+        CHECK_THROWS_AS(ContainerFile::decode(garbage, sorted, primes), runtime_error);
+
+        MagicalContainer loaded;
+        CHECK_THROWS_AS(loaded.load(path + ".missing"), runtime_error);
+    }
+
+    SUBCASE("A failed save keeps the previous file") {
+        // A file size limit makes the new version fail part-way
+        rlimit unlimited{};
+        getrlimit(RLIMIT_FSIZE, &unlimited);
+        rlimit limited = unlimited;
+        limited.rlim_cur = 100;
+        auto previous = signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &limited);
+        MagicalContainer copy = original;
+        copy.addElement(1);
+        CHECK_THROWS_AS(copy.save(path), runtime_error);
+        setrlimit(RLIMIT_FSIZE, &unlimited);
+        signal(SIGXFSZ, previous);
+
+        MagicalContainer loaded;
+        loaded.load(path);
+        checkSameTraversals(original, loaded);
+        CHECK_FALSE(filesystem::exists(path + ".tmp"));
+    }
+    filesystem::remove(path);
+}
+
+TEST_CASE("Memory-mapped read-only containers") {
+    string path = (filesystem::temp_directory_path() / "magical_container_mapped.bin").string();
+    MagicalContainer original;
+    vector<int> values = {2147483647, -2147483647 - 1, -13, 0};
+    for (int i = 0; i < 3000; ++i) {
+        values.push_back(i * 11 + 1);
+    }
+    original.applyBatch(values, {});
+    ContainerFile::save(original, path, ContainerFile::Encoding::Raw);
+
+    {
+        MappedMagicalContainer mapped(path);
+        CHECK(mapped.backend() == StorageBackend::Mapped);
+        checkSameTraversals(original, mapped);
+        CHECK(mapped.memoryFootprint().values.reserved == 0);
+
+        MagicalContainer::PrimeIterator primes(mapped);
+        CHECK(*primes == -13);
+        MagicalContainer::SideCrossIterator cross(mapped);
+        ++cross;
+        CHECK(*cross == 2147483647);
+
+        CHECK_THROWS_AS(mapped.addElement(4), runtime_error);
+        CHECK_THROWS_AS(mapped.removeElement(1), runtime_error);
+        CHECK_THROWS_AS(mapped.applyBatch({4}, {}), runtime_error);
+        CHECK(mapped.size() == original.size());
+
+        MagicalContainer copy = mapped;
+        copy.useBackend(StorageBackend::Indexed);
+        copy.addElement(4);
+        CHECK(copy.size() == mapped.size() + 1);
+
+        MagicalContainer loaded;
+        loaded.load(path);
+        checkSameTraversals(original, loaded);
+
+        // Replacing the contents would otherwise leave a writable store behind the mapped layout
+        string small = (filesystem::temp_directory_path() / "magical_container_mapped_small.bin").string();
+        MagicalContainer::fromSorted(vector<int>{1, 2}).save(small);
+        CHECK_THROWS_WITH_AS(mapped.load(small), "Error: mapped container is read-only", runtime_error);
+        CHECK_THROWS_AS(mapped.load(path), runtime_error);
+        CHECK_THROWS_AS(mapped.assignSorted(vector<int>{1, 2, 3}), runtime_error);
+        CHECK(mapped.backend() == StorageBackend::Mapped);
+        CHECK_THROWS_AS(mapped.addElement(99), runtime_error);
+        checkSameTraversals(original, mapped);
+        filesystem::remove(small);
+
+        MappedMagicalContainer source(path);
+        MagicalContainer moved(move(source));
+        checkSameTraversals(original, moved);
+        CHECK(source.backend() == StorageBackend::Indexed);
+        for (int i = 0; i < 20; ++i) {
+            source.addElement(i);
+        }
+        CHECK(source.size() == 20);
+    }
+
+    // The prime positions of {2, 3, 4} are 0 and 1, stored in the last 8 bytes of a Raw file
+    for (uint32_t corrupt : {uint32_t{3}, uint32_t{0}}) {
+        ContainerFile::save(MagicalContainer::fromSorted(vector<int>{2, 3, 4}), path, ContainerFile::Encoding::Raw);
+        fstream file(path, ios::binary | ios::in | ios::out);
+        file.seekp(-4, ios::end);
+        file.write(reinterpret_cast<const char *>(&corrupt), sizeof(corrupt));
+        file.close();
+        CHECK_THROWS_WITH_AS(MappedMagicalContainer{path}, "Error: corrupt container file", runtime_error);
+    }
+
+    // The values of {2, 3, 4} follow the 32-byte header; writing 5 over the 3 breaks their order
+    {
+        ContainerFile::save(MagicalContainer::fromSorted(vector<int>{2, 3, 4}), path, ContainerFile::Encoding::Raw);
+        int32_t outOfOrder = 5;
+        fstream file(path, ios::binary | ios::in | ios::out);
+        file.seekp(ContainerFile::HeaderSize + 4);
+        file.write(reinterpret_cast<const char *>(&outOfOrder), sizeof(outOfOrder));
+        file.close();
+        CHECK_THROWS_WITH_AS(MappedMagicalContainer{path}, "Error: corrupt container file", runtime_error);
+    }
+
+    original.save(path);
+    CHECK_THROWS_AS(MappedMagicalContainer{path}, runtime_error);
+    filesystem::remove(path);
+    CHECK_THROWS_AS(MappedMagicalContainer{path}, runtime_error);
+}
+
+TEST_CASE("Streaming integers from text") {
+    SUBCASE("Mixed separators and tokens split across chunks") {
+        string text = "12, -7;3\n\n  2147483647\t-2147483648\r\n5,5,5\n100000";
+        for (size_t chunk : {size_t{12}, size_t{13}, size_t{64}, TextIngest::ChunkSize}) {
+            MagicalContainer container;
+            istringstream input(text);
+            CHECK(TextIngest::load(container, input, chunk, 2) == 9);
+            CHECK(traversal(container, TraversalMode::Ascending) == vector<int>{-2147483647 - 1, -7, 3, 5, 12, 100000, 2147483647});
+            CHECK(traversal(container, TraversalMode::Prime) == vector<int>{-7, 3, 5, 2147483647});
+        }
+    }
+
+    SUBCASE("A large generated stream") {
+        ostringstream text;
+        for (int i = 0; i < 50000; ++i) {
+            text << (i * 7 - 100000) << (i % 10 == 9 ? "\n" : ",");
+        }
+        MagicalContainer container;
+        istringstream input(text.str());
+        CHECK(TextIngest::load(container, input, 4096, 1000) == 50000);
+        CHECK(container.size() == 50000);
+        CHECK(container.at(TraversalMode::Ascending, 49999) == 49999 * 7 - 100000);
+    }
+
+    SUBCASE("Bad input is rejected") {
+        MagicalContainer container;
+        istringstream word("1 2 three 4");
+        CHECK_THROWS_AS(TextIngest::load(container, word), runtime_error);
+        istringstream overflow("2147483648");
+        CHECK_THROWS_AS(TextIngest::load(container, overflow), runtime_error);
+        istringstream empty("");
+        CHECK(TextIngest::load(container, empty) == 0);
+        CHECK_THROWS_AS(TextIngest::loadFile(container, "/nonexistent/values.txt"), runtime_error);
+    }
+}
+
+TEST_CASE("Write-ahead log of modifications") {
+    string path = (filesystem::temp_directory_path() / "magical_container_test.wal").string();
+    filesystem::remove(path);
+
+    MagicalContainer expected;
+    {
+        MagicalContainer container;
+        WriteAheadLog log(container, path, WriteAheadLog::SyncPolicy::Commit, 3);
+        for (int i = -20; i <= 20; ++i) {
+            log.addElement(i);
+            expected.addElement(i);
+        }
+        CHECK(log.pending() == 41 % 3);
+        for (int i = -20; i <= 20; i += 4) {
+            log.removeElement(i);
+            expected.removeElement(i);
+        }
+        log.addElement(0);
+        expected.addElement(0);
+        checkSameTraversals(container, expected);
+    }
+
+    SUBCASE("Reopening a log replays it") {
+        MagicalContainer container;
+        WriteAheadLog log(container, path, WriteAheadLog::SyncPolicy::None);
+        checkSameTraversals(container, expected);
+
+        log.addElement(1000);
+        log.commit();
+        CHECK(log.pending() == 0);
+        MagicalContainer replayed;
+        CHECK(WriteAheadLog::replay(replayed, path) == 41 + 11 + 1 + 1);
+        CHECK(replayed.size() == expected.size() + 1);
+    }
+
+    SUBCASE("A torn group is ignored and cut off") {
+        auto complete = filesystem::file_size(path);
+        {
+            ofstream file(path, ios::binary | ios::app);
+            file << string("\x05\x00\x00\x00\x01\x02\x03\x04\x01\x07", 10);
+        }
+
+        MagicalContainer container;
+        {
+            WriteAheadLog log(container, path);
+            CHECK(filesystem::file_size(path) == complete);
+            log.addElement(777);
+        }
+        expected.addElement(777);
+
+        MagicalContainer replayed;
+        WriteAheadLog::replay(replayed, path);
+        checkSameTraversals(replayed, expected);
+    }
+
+    SUBCASE("A group cut short by a failed write is truncated and kept pending") {
+        auto complete = filesystem::file_size(path);
+        MagicalContainer container;
+        WriteAheadLog log(container, path, WriteAheadLog::SyncPolicy::None);
+        log.addElement(555);
+        log.addElement(556);
+
+        // A file size limit lets the first bytes of the group through and fails the rest
+        rlimit original{};
+        getrlimit(RLIMIT_FSIZE, &original);
+        rlimit limited = original;
+        limited.rlim_cur = static_cast<rlim_t>(complete + 5);
+        auto previous = signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &limited);
+        CHECK_THROWS_AS(log.commit(), runtime_error);
+        setrlimit(RLIMIT_FSIZE, &original);
+        signal(SIGXFSZ, previous);
+
+        CHECK(filesystem::file_size(path) == complete);
+        CHECK(log.pending() == 2);
+        log.commit();
+        expected.addElement(555);
+        expected.addElement(556);
+
+        MagicalContainer replayed;
+        WriteAheadLog::replay(replayed, path);
+        checkSameTraversals(replayed, expected);
+    }
+
+    SUBCASE("Other files are rejected") {
+        {
+            ofstream file(path, ios::binary | ios::trunc);
+            file << "not a log at all";
+        }
+        MagicalContainer container;
+        CHECK_THROWS_AS(WriteAheadLog::replay(container, path), runtime_error);
+        CHECK(WriteAheadLog::replay(container, path + ".missing") == 0);
+    }
+
+    filesystem::remove(path);
+}
+
+TEST_CASE("Incremental checkpoints") {
+    filesystem::path directory = filesystem::temp_directory_path() / "magical_container_checkpoints";
+    filesystem::remove_all(directory);
+    auto logCount = [&directory]() {
+        size_t logs = 0;
+        for (const auto &entry : filesystem::directory_iterator(directory)) {
+            logs += entry.path().extension() == ".wal" ? 1U : 0U;
+        }
+        return logs;
+    };
+
+    MagicalContainer expected;
+    {
+        MagicalContainer container;
+        Checkpointer checkpointer(container, directory.string(), WriteAheadLog::SyncPolicy::None);
+        for (int i = 0; i < 3000; ++i) {
+            checkpointer.addElement(i * 50 - 70000);
+            expected.addElement(i * 50 - 70000);
+        }
+        CHECK(checkpointer.dirtyBlocks() == 4);
+        CHECK(checkpointer.checkpoint() == 4);
+        CHECK(checkpointer.dirtyBlocks() == 0);
+        CHECK(logCount() == 1);
+
+        // Only the block of the modified elements is written again
+        checkpointer.removeElement(100);
+        checkpointer.addElement(101);
+        expected.removeElement(100);
+        expected.addElement(101);
+        CHECK(checkpointer.checkpoint() == 1);
+        CHECK(checkpointer.generation() == 2);
+
+        // The container keeps changing while a checkpoint runs in the background
+        auto running = checkpointer.startCheckpoint();
+        for (int i = 0; i < 100; ++i) {
+            checkpointer.removeElement(i * 50 - 70000);
+            expected.removeElement(i * 50 - 70000);
+        }
+        running.wait();
+        checkSameTraversals(container, expected);
+    }
+
+    SUBCASE("Blocks and the newest log recover the container") {
+        MagicalContainer container;
+        Checkpointer checkpointer(container, directory.string());
+        checkSameTraversals(container, expected);
+
+        // The replayed log makes the next checkpoint rewrite every block, after which one empty log is left
+        CHECK(checkpointer.checkpoint() == 4);
+        CHECK(logCount() == 1);
+
+        MagicalContainer recovered;
+        Checkpointer again(recovered, (directory / "").string());
+        checkSameTraversals(recovered, expected);
+    }
+
+    SUBCASE("Emptied blocks are deleted") {
+        MagicalContainer container;
+        {
+            Checkpointer checkpointer(container, directory.string());
+            for (int i = 100; i < 3000; ++i) {
+                if (i * 50 - 70000 != 100) {
+                    checkpointer.removeElement(i * 50 - 70000);
+                }
+            }
+            checkpointer.checkpoint();
+        }
+        CHECK(distance(filesystem::directory_iterator(directory), filesystem::directory_iterator()) == 3);
+
+        MagicalContainer recovered;
+        Checkpointer checkpointer(recovered, directory.string());
+        CHECK(recovered.size() == 1);
+    }
+
+    SUBCASE("A finished checkpoint releases its snapshot") {
+        CountingResource counting;
+        MagicalContainer container(&counting);
+        Checkpointer checkpointer(container, directory.string());
+        checkpointer.checkpoint();
+
+        // A snapshot still held would make this removal copy every element, at 4 bytes or more each
+        size_t allocated = counting.allocated;
+        checkpointer.removeElement(101);
+        CHECK(counting.allocated - allocated < container.size());
+        checkpointer.checkpoint();
+    }
+
+    filesystem::remove_all(directory);
+}
+
+TEST_CASE("Buffered export of traversal orders") {
+    MagicalContainer container;
+    for (int i = -500; i <= 1500; i += 3) {
+        container.addElement(i);
+    }
+    container.addElement(-2147483647 - 1);
+    container.addElement(2147483647);
+
+    auto readBack = [](FILE *file) {
+        string bytes;
+        rewind(file);
+        for (int character = fgetc(file); character != EOF; character = fgetc(file)) {
+            bytes.push_back(static_cast<char>(character));
+        }
+        return bytes;
+    };
+
+    for (TraversalMode mode : {TraversalMode::Ascending, TraversalMode::SideCross, TraversalMode::Prime}) {
+        string expectedText;
+        for (int element : traversal(container, mode)) {
+            expectedText += to_string(element) + "\n";
+        }
+
+        FILE *file = tmpfile();
+        REQUIRE(file != nullptr);
+        CHECK(TraversalExport::write(container, mode, fileno(file), ExportFormat::Text, 16) == container.count(mode));
+        CHECK(readBack(file) == expectedText);
+        fclose(file);
+
+        // Binary exports are the elements in little-endian order
+        file = tmpfile();
+        REQUIRE(file != nullptr);
+        container.exportTo(mode, fileno(file), ExportFormat::Binary);
+        string bytes = readBack(file);
+        REQUIRE(bytes.size() == container.count(mode) * 4);
+        for (size_t position = 0; position < container.count(mode); ++position) {
+            uint32_t bits = 0;
+            for (size_t byte = 0; byte < 4; ++byte) {
+                bits |= uint32_t{static_cast<uint8_t>(bytes[position * 4 + byte])} << (8 * byte);
+            }
+            if (static_cast<int>(bits) != container.at(mode, position)) {
+                FAIL_CHECK("Binary export differs at position " << position);
+            }
+        }
+        fclose(file);
+    }
+
+    SUBCASE("A text export loads back") {
+        string path = (filesystem::temp_directory_path() / "magical_container_export.txt").string();
+        CHECK(container.exportTo(TraversalMode::SideCross, path) == container.size());
+
+        MagicalContainer loaded;
+        ifstream input(path);
+        TextIngest::load(loaded, input);
+        checkSameTraversals(loaded, container);
+        filesystem::remove(path);
+
+        CHECK_THROWS_AS(container.exportTo(TraversalMode::Prime, "/nonexistent/export.txt"), runtime_error);
+        CHECK_THROWS_AS(container.exportTo(TraversalMode::Prime, -1), runtime_error);
+    }
+}
+
+TEST_CASE("Loading already sorted elements") {
+    vector<int> sorted;
+    for (int i = -3000; i <= 3000; i += 7) {
+        sorted.push_back(i);
+    }
+
+    for (StorageBackend backend : {StorageBackend::Indexed, StorageBackend::Compressed, StorageBackend::Bitmap}) {
+        MagicalContainer expected(backend);
+        for (int element : sorted) {
+            expected.addElement(element);
+        }
+
+        MagicalContainer container = MagicalContainer::fromSorted(sorted, backend);
+        CHECK(container.backend() == backend);
+        checkSameTraversals(container, expected);
+
+        // Small sequences stay inline, and a reload replaces the previous contents
+        container.assignSorted(span(sorted).first(5));
+        CHECK(traversal(container, TraversalMode::Ascending) == vector<int>(sorted.begin(), sorted.begin() + 5));
+        container.assignSorted({});
+        CHECK(container.size() == 0);
+    }
+
+    SUBCASE("Unsorted input is rejected and changes nothing") {
+        MagicalContainer container = MagicalContainer::fromSorted(sorted);
+        vector<int> duplicate{1, 2, 2, 3};
+        vector<int> descending{5, 3};
+        CHECK_THROWS_AS(container.assignSorted(duplicate), invalid_argument);
+        CHECK_THROWS_AS(container.assignSorted(descending), invalid_argument);
+        CHECK(container.size() == sorted.size());
+        CHECK_THROWS_AS(MagicalContainer::fromSorted(descending), invalid_argument);
+    }
+}
+
+TEST_CASE("Set algebra between containers") {
+    set<int> firstSet, secondSet;
+    MagicalContainer first(StorageBackend::Indexed), second(StorageBackend::Bitmap);
+    for (int i = 0; i < 2000; ++i) {
+        int element = (i * 7919) % 5003 - 2500;
+        firstSet.insert(element);
+        first.addElement(element);
+        element = (i * 104729) % 4001 - 1000;
+        secondSet.insert(element);
+        second.addElement(element);
+    }
+
+    auto containerOf = [](const vector<int> &elements) {
+        MagicalContainer container;
+        for (int element : elements) {
+            container.addElement(element);
+        }
+        return container;
+    };
+    vector<int> unionElements, intersectionElements, differenceElements;
+    set_union(firstSet.begin(), firstSet.end(), secondSet.begin(), secondSet.end(), back_inserter(unionElements));
+    set_intersection(firstSet.begin(), firstSet.end(), secondSet.begin(), secondSet.end(), back_inserter(intersectionElements));
+    set_difference(firstSet.begin(), firstSet.end(), secondSet.begin(), secondSet.end(), back_inserter(differenceElements));
+
+    SUBCASE("New containers") {
+        MagicalContainer united = MagicalContainer::setUnion(first, second);
+        CHECK(united.backend() == StorageBackend::Indexed);
+        checkSameTraversals(united, containerOf(unionElements));
+        checkSameTraversals(MagicalContainer::setIntersection(first, second), containerOf(intersectionElements));
+        checkSameTraversals(MagicalContainer::setDifference(first, second), containerOf(differenceElements));
+
+        vector<int> reverseDifference;
+        set_difference(secondSet.begin(), secondSet.end(), firstSet.begin(), firstSet.end(), back_inserter(reverseDifference));
+        MagicalContainer reverse = MagicalContainer::setDifference(second, first);
+        CHECK(reverse.backend() == StorageBackend::Bitmap);
+        checkSameTraversals(reverse, containerOf(reverseDifference));
+    }
+
+    SUBCASE("In place") {
+        MagicalContainer united = first, intersected = first, subtracted = first;
+        united.unionWith(second);
+        intersected.intersectWith(second);
+        subtracted.subtract(second);
+        checkSameTraversals(united, containerOf(unionElements));
+        checkSameTraversals(intersected, containerOf(intersectionElements));
+        checkSameTraversals(subtracted, containerOf(differenceElements));
+
+        // Snapshots keep the contents from before
+        MagicalContainer snapshot = second.snapshot();
+        second.intersectWith(second);
+        checkSameTraversals(second, snapshot);
+        second.subtract(second);
+        CHECK(second.size() == 0);
+        CHECK(snapshot.size() == secondSet.size());
+    }
+
+    SUBCASE("Mapped containers are read-only operands") {
+        string path = (filesystem::temp_directory_path() / "magical_container_algebra.bin").string();
+        ContainerFile::save(first, path, ContainerFile::Encoding::Raw);
+        {
+            MappedMagicalContainer mapped(path);
+            CHECK_THROWS_AS(mapped.unionWith(second), runtime_error);
+            MagicalContainer difference = MagicalContainer::setDifference(mapped, second);
+            CHECK(difference.backend() == StorageBackend::Indexed);
+            checkSameTraversals(difference, containerOf(differenceElements));
+        }
+        filesystem::remove(path);
+    }
+}
+
+TEST_CASE("Range queries over the ascending order") {
+    for (StorageBackend backend : {StorageBackend::Indexed, StorageBackend::Compressed, StorageBackend::Bitmap}) {
+        MagicalContainer container(backend);
+        vector<int> elements;
+        for (int i = -300; i <= 300; i += 3) {
+            container.addElement(i);
+            elements.push_back(i);
+        }
+
+        for (auto [low, high] : {pair{-100, 100}, pair{-1000, -200}, pair{7, 7}, pair{6, 6}, pair{50, 10}, pair{-2147483647 - 1, 2147483647}}) {
+            vector<int> inside, primesInside;
+            for (int element : elements) {
+                if (element >= low && element <= high) {
+                    inside.push_back(element);
+                    if (ElementStore::isPrime(element)) {
+                        primesInside.push_back(element);
+                    }
+                }
+            }
+
+            CHECK(container.countInRange(low, high) == inside.size());
+            CHECK(container.primeCountInRange(low, high) == primesInside.size());
+
+            RangeView view = container.range(low, high);
+            CHECK(vector<int>(view.begin(TraversalMode::Ascending), view.end(TraversalMode::Ascending)) == inside);
+            CHECK(vector<int>(view.begin(TraversalMode::Prime), view.end(TraversalMode::Prime)) == primesInside);
+
+            vector<int> sideCross;
+            for (int element : view.order(TraversalMode::SideCross)) {
+                sideCross.push_back(element);
+            }
+            CHECK(sideCross == traversal(MagicalContainer::fromSorted(inside), TraversalMode::SideCross));
+            CHECK_THROWS_AS(view.at(TraversalMode::Ascending, inside.size()), out_of_range);
+        }
+
+        CHECK(container.rank(TraversalMode::Ascending, 0) == 100);
+        CHECK(container.rank(TraversalMode::Ascending, 0, true) == 101);
+        CHECK_THROWS_AS(container.rank(TraversalMode::SideCross, 0), invalid_argument);
+    }
+
+    SUBCASE("Views hold a snapshot") {
+        MagicalContainer container;
+        for (int i = 1; i <= 10; ++i) {
+            container.addElement(i);
+        }
+        RangeView view = container.range(3, 8);
+        container.removeElement(5);
+        CHECK(view.count(TraversalMode::Ascending) == 6);
+        CHECK(view.count(TraversalMode::Prime) == 3);
+        CHECK(container.countInRange(3, 8) == 5);
+        CHECK(container.primeCountInRange(3, 8) == 2);
+    }
+
+    SUBCASE("Orders of a temporary view stay valid") {
+        MagicalContainer container;
+        for (int i = 1; i <= 30; ++i) {
+            container.addElement(i);
+        }
+
+        vector<int> primes;
+        for (int element : container.range(10, 20).order(TraversalMode::Prime)) {
+            primes.push_back(element);
+        }
+        CHECK(primes == vector<int>{11, 13, 17, 19});
+
+        // Equal positions in different orders or views are different iterators
+        RangeView view = container.range(1, 10);
+        RangeView other = container.range(1, 10);
+        CHECK(view.begin(TraversalMode::Ascending) == view.begin(TraversalMode::Ascending));
+        CHECK_FALSE(view.begin(TraversalMode::Ascending) == view.begin(TraversalMode::SideCross));
+        CHECK_FALSE(view.begin(TraversalMode::Ascending) == other.begin(TraversalMode::Ascending));
+    }
+}
+
+TEST_CASE("Lookups return positioned iterators") {
+    for (size_t size : {size_t{10}, size_t{500}}) {
+        MagicalContainer container;
+        for (size_t i = 0; i < size; ++i) {
+            container.addElement(static_cast<int>(i * 4) - 20);
+        }
+        MagicalContainer::AscendingIterator ascendingEnd = MagicalContainer::AscendingIterator(container).end();
+        MagicalContainer::PrimeIterator primeEnd = MagicalContainer::PrimeIterator(container).end();
+
+        CHECK(container.contains(-20));
+        CHECK(container.contains(16));
+        CHECK_FALSE(container.contains(17));
+        CHECK_FALSE(container.contains(-24));
+
+        CHECK(*container.find(16) == 16);
+        CHECK(container.find(17) == ascendingEnd);
+        CHECK(*container.lowerBound(13) == 16);
+        CHECK(*container.lowerBound(12) == 12);
+        CHECK(*container.upperBound(12) == 16);
+        CHECK(container.upperBound(static_cast<int>(size * 4) - 24) == ascendingEnd);
+        CHECK(*container.lowerBound(-1000) == -20);
+        CHECK(container.upperBound(100000) == ascendingEnd);
+
+        // Every element here is a multiple of 4, so only -2 and 2 could be prime, and neither is present
+        CHECK(container.primeLowerBound(0) == primeEnd);
+
+        // Paging from the middle visits the rest of the order
+        vector<int> page;
+        for (auto it = container.lowerBound(0); it != ascendingEnd && page.size() < 3; ++it) {
+            page.push_back(*it);
+        }
+        CHECK(page == vector<int>{0, 4, 8});
+    }
+
+    SUBCASE("Prime bounds") {
+        MagicalContainer container;
+        for (int i = -30; i <= 30; ++i) {
+            container.addElement(i);
+        }
+        CHECK(*container.primeLowerBound(8) == 11);
+        CHECK(*container.primeLowerBound(11) == 11);
+        CHECK(*container.primeUpperBound(11) == 13);
+        CHECK(*container.primeLowerBound(-30) == -29);
+        CHECK(container.primeUpperBound(29) == MagicalContainer::PrimeIterator(container).end());
+
+        vector<int> primesFromTen;
+        for (auto it = container.primeLowerBound(10); it != it.end(); ++it) {
+            primesFromTen.push_back(*it);
+        }
+        CHECK(primesFromTen == vector<int>{11, 13, 17, 19, 23, 29});
+    }
+}
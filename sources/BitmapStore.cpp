@@ -0,0 +1,800 @@
+#include "BitmapStore.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+
+namespace ariel{
+BitmapChunk::BitmapChunk(pmr::memory_resource *resource)
+    : array(resource), words(resource), ranks(resource), runs(resource), runRanks(resource) {}
+
+BitmapChunk::BitmapChunk(const BitmapChunk &other, pmr::memory_resource *resource)
+    : layout(other.layout), values(other.values), array(other.array, resource), words(other.words, resource),
+      ranks(other.ranks, resource), runs(other.runs, resource), runRanks(other.runRanks, resource) {}
+
+BitmapChunk::Kind BitmapChunk::kind() const
+{
+    return layout;
+}
+
+size_t BitmapChunk::cardinality() const
+{
+    return values;
+}
+
+bool BitmapChunk::contains(uint16_t value) const
+{
+    switch (layout)
+    {
+    case Kind::Array:
+        return binary_search(array.begin(), array.end(), value);
+    case Kind::Bitmap:
+        return ((words[value / 64] >> (value % 64)) & 1U) != 0;
+    case Kind::Run:
+    {
+        auto next = upper_bound(runs.begin(), runs.end(), value, [](uint16_t v, const Run &run) { return v < run.first; });
+        return next != runs.begin() && value <= prev(next)->last;
+    }
+    }
+
+    return false;
+}
+
+bool BitmapChunk::insert(uint16_t value)
+{
+    switch (layout)
+    {
+    case Kind::Array:
+    {
+        auto it = lower_bound(array.begin(), array.end(), value);
+        if (it != array.end() && *it == value)
+        {
+            return false;
+        }
+
+        array.insert(it, value);
+        if (++values > ArrayLimit)
+        {
+            toBitmap();
+        }
+        return true;
+    }
+    case Kind::Bitmap:
+    {
+        uint64_t &word = words[value / 64];
+        uint64_t bit = uint64_t{1} << (value % 64);
+        if ((word & bit) != 0)
+        {
+            return false;
+        }
+
+        word |= bit;
+        ++values;
+        for (size_t block = value / 64 / RankWords + 1; block < ranks.size(); ++block)
+        {
+            ++ranks[block];
+        }
+        return true;
+    }
+    case Kind::Run:
+    {
+        auto next = upper_bound(runs.begin(), runs.end(), value, [](uint16_t v, const Run &run) { return v < run.first; });
+        bool joinsNext = next != runs.end() && next->first == value + 1;
+
+        // Only the run before the value and the ones after it change
+        auto position = static_cast<size_t>(next - runs.begin());
+        size_t from = position > 0 ? position - 1 : 0;
+
+        if (next != runs.begin())
+        {
+            Run &previous = *prev(next);
+            if (value <= previous.last)
+            {
+                return false;
+            }
+
+            if (value == previous.last + 1)
+            {
+                previous.last = joinsNext ? next->last : value;
+                if (joinsNext)
+                {
+                    runs.erase(next);
+                }
+                ++values;
+                rebuildRunRanks(from);
+                return true;
+            }
+        }
+
+        ++values;
+        if (joinsNext)
+        {
+            next->first = value;
+        }
+        else
+        {
+            runs.insert(next, Run{value, value});
+            if (runs.size() > RunLimit)
+            {
+                toBitmap();
+                return true;
+            }
+        }
+        rebuildRunRanks(from);
+        return true;
+    }
+    }
+
+    return false;
+}
+
+bool BitmapChunk::erase(uint16_t value)
+{
+    switch (layout)
+    {
+    case Kind::Array:
+    {
+        auto it = lower_bound(array.begin(), array.end(), value);
+        if (it == array.end() || *it != value)
+        {
+            return false;
+        }
+
+        array.erase(it);
+        --values;
+        return true;
+    }
+    case Kind::Bitmap:
+    {
+        uint64_t &word = words[value / 64];
+        uint64_t bit = uint64_t{1} << (value % 64);
+        if ((word & bit) == 0)
+        {
+            return false;
+        }
+
+        word &= ~bit;
+        --values;
+        for (size_t block = value / 64 / RankWords + 1; block < ranks.size(); ++block)
+        {
+            --ranks[block];
+        }
+
+        if (values <= ArrayLimit)
+        {
+            toArray();
+        }
+        return true;
+    }
+    case Kind::Run:
+    {
+        auto next = upper_bound(runs.begin(), runs.end(), value, [](uint16_t v, const Run &run) { return v < run.first; });
+        if (next == runs.begin() || value > prev(next)->last)
+        {
+            return false;
+        }
+
+        auto run = prev(next);
+        auto from = static_cast<size_t>(run - runs.begin());
+        --values;
+
+        if (run->first == run->last)
+        {
+            runs.erase(run);
+        }
+        else if (value == run->first)
+        {
+            run->first = static_cast<uint16_t>(value + 1);
+        }
+        else if (value == run->last)
+        {
+            run->last = static_cast<uint16_t>(value - 1);
+        }
+        else
+        {
+            Run tail{static_cast<uint16_t>(value + 1), run->last};
+            run->last = static_cast<uint16_t>(value - 1);
+            runs.insert(next, tail);
+
+            if (runs.size() > RunLimit)
+            {
+                toBitmap();
+                return true;
+            }
+        }
+        rebuildRunRanks(from);
+        return true;
+    }
+    }
+
+    return false;
+}
+
+uint16_t BitmapChunk::select(size_t rank) const
+{
+    switch (layout)
+    {
+    case Kind::Array:
+        return array[rank];
+    case Kind::Bitmap:
+    {
+        // The rank table narrows the search to RankWords words, popcount finds the word, then the bit
+        auto next = upper_bound(ranks.begin(), ranks.end(), rank, [](size_t r, uint16_t before) { return r < before; });
+        auto block = static_cast<size_t>(next - ranks.begin()) - 1;
+        size_t remaining = rank - ranks[block];
+
+        for (size_t word = block * RankWords;; ++word)
+        {
+            uint64_t bits = words[word];
+            auto ones = static_cast<size_t>(popcount(bits));
+
+            if (remaining < ones)
+            {
+                for (; remaining > 0; --remaining)
+                {
+                    bits &= bits - 1;
+                }
+                return static_cast<uint16_t>(word * 64 + static_cast<size_t>(countr_zero(bits)));
+            }
+
+            remaining -= ones;
+        }
+    }
+    case Kind::Run:
+    {
+        // The last run with at most rank values before it holds the value
+        auto next = upper_bound(runRanks.begin(), runRanks.end(), rank, [](size_t r, uint16_t before) { return r < before; });
+        auto run = static_cast<size_t>(next - runRanks.begin()) - 1;
+        return static_cast<uint16_t>(runs[run].first + (rank - runRanks[run]));
+    }
+    }
+
+    throw out_of_range("Iterator out of range");
+}
+
+void BitmapChunk::assign(span<const uint16_t> sorted)
+{
+    array.clear();
+    words.clear();
+    ranks.clear();
+    runs.clear();
+    runRanks.clear();
+    values = static_cast<uint32_t>(sorted.size());
+
+    size_t runCount = 0;
+    for (size_t index = 0; index < sorted.size(); ++index)
+    {
+        if (index == 0 || sorted[index] != sorted[index - 1] + 1)
+        {
+            ++runCount;
+        }
+    }
+
+    size_t arrayBytes = sorted.size() * sizeof(uint16_t);
+    size_t bitmapBytes = BitmapWords * sizeof(uint64_t) + BitmapWords / RankWords * sizeof(uint16_t);
+    size_t runBytes = runCount * sizeof(Run);
+
+    if (runBytes < min(arrayBytes, bitmapBytes))
+    {
+        layout = Kind::Run;
+        runs.reserve(runCount);
+        for (size_t index = 0; index < sorted.size(); ++index)
+        {
+            if (index == 0 || sorted[index] != sorted[index - 1] + 1)
+            {
+                runs.push_back(Run{sorted[index], sorted[index]});
+            }
+            else
+            {
+                runs.back().last = sorted[index];
+            }
+        }
+        rebuildRunRanks(0);
+    }
+    else if (sorted.size() <= ArrayLimit)
+    {
+        layout = Kind::Array;
+        array.assign(sorted.begin(), sorted.end());
+    }
+    else
+    {
+        layout = Kind::Bitmap;
+        words.assign(BitmapWords, 0);
+        for (uint16_t value : sorted)
+        {
+            words[value / 64] |= uint64_t{1} << (value % 64);
+        }
+        rebuildRanks();
+    }
+}
+
+void BitmapChunk::assignIntersection(const BitmapChunk &bitmap, const uint64_t *mask)
+{
+    array.clear();
+    runs.clear();
+    runRanks.clear();
+    layout = Kind::Bitmap;
+    words.resize(BitmapWords);
+
+    size_t ones = 0;
+    for (size_t word = 0; word < BitmapWords; ++word)
+    {
+        words[word] = bitmap.words[word] & mask[word];
+        ones += static_cast<size_t>(popcount(words[word]));
+    }
+    values = static_cast<uint32_t>(ones);
+
+    if (values <= ArrayLimit)
+    {
+        toArray();
+    }
+    else
+    {
+        rebuildRanks();
+    }
+}
+
+Footprint BitmapChunk::footprint() const
+{
+    Footprint bytes = Footprint::of(array);
+    bytes += Footprint::of(words);
+    bytes += Footprint::of(ranks);
+    bytes += Footprint::of(runs);
+    bytes += Footprint::of(runRanks);
+    return bytes;
+}
+
+void BitmapChunk::toBitmap()
+{
+    words.assign(BitmapWords, 0);
+
+    if (layout == Kind::Array)
+    {
+        for (uint16_t value : array)
+        {
+            words[value / 64] |= uint64_t{1} << (value % 64);
+        }
+    }
+    else if (layout == Kind::Run)
+    {
+        for (const Run &run : runs)
+        {
+            for (uint32_t value = run.first; value <= run.last; ++value)
+            {
+                words[value / 64] |= uint64_t{1} << (value % 64);
+            }
+        }
+    }
+
+    array.clear();
+    array.shrink_to_fit();
+    runs.clear();
+    runs.shrink_to_fit();
+    runRanks.clear();
+    runRanks.shrink_to_fit();
+    layout = Kind::Bitmap;
+    rebuildRanks();
+}
+
+void BitmapChunk::toArray()
+{
+    array.clear();
+    array.reserve(values);
+
+    for (size_t word = 0; word < BitmapWords; ++word)
+    {
+        for (uint64_t bits = words[word]; bits != 0; bits &= bits - 1)
+        {
+            array.push_back(static_cast<uint16_t>(word * 64 + static_cast<size_t>(countr_zero(bits))));
+        }
+    }
+
+    words.clear();
+    words.shrink_to_fit();
+    ranks.clear();
+    ranks.shrink_to_fit();
+    layout = Kind::Array;
+}
+
+void BitmapChunk::rebuildRanks()
+{
+    ranks.resize(BitmapWords / RankWords);
+
+    size_t before = 0;
+    for (size_t block = 0; block < ranks.size(); ++block)
+    {
+        ranks[block] = static_cast<uint16_t>(before);
+        for (size_t word = block * RankWords; word < (block + 1) * RankWords; ++word)
+        {
+            before += static_cast<size_t>(popcount(words[word]));
+        }
+    }
+}
+
+void BitmapChunk::rebuildRunRanks(size_t from)
+{
+    runRanks.resize(runs.size());
+
+    size_t before = 0;
+    if (from > 0)
+    {
+        before = runRanks[from - 1] + static_cast<size_t>(runs[from - 1].last - runs[from - 1].first) + 1;
+    }
+
+    for (size_t run = from; run < runs.size(); ++run)
+    {
+        runRanks[run] = static_cast<uint16_t>(before);
+        before += static_cast<size_t>(runs[run].last - runs[run].first) + 1;
+    }
+}
+
+// Batches adding at least this many elements to one bucket find its primes by intersecting with a sieved mask
+static constexpr size_t SieveThreshold = 1024;
+
+BitmapStore::BitmapStore(pmr::memory_resource *resource)
+    : memory(resource), buckets(resource), valueRanks(resource), primeRanks(resource) {}
+
+BitmapStore::BitmapStore(const BitmapStore &other)
+    : ElementStore(other), memory(other.memory), buckets(other.memory), valueRanks(other.valueRanks, other.memory),
+      primeRanks(other.primeRanks, other.memory), elementCount(other.elementCount), primeCount(other.primeCount)
+{
+    buckets.reserve(other.buckets.size());
+    for (const Bucket &original : other.buckets)
+    {
+        buckets.push_back(Bucket{original.high, BitmapChunk(original.values, memory), BitmapChunk(original.primes, memory)});
+    }
+}
+
+shared_ptr<ElementStore> BitmapStore::clone() const
+{
+    return allocate_shared<BitmapStore>(pmr::polymorphic_allocator<BitmapStore>(memory), *this);
+}
+
+StorageBackend BitmapStore::backend() const
+{
+    return StorageBackend::Bitmap;
+}
+
+pmr::memory_resource *BitmapStore::resource() const
+{
+    return memory;
+}
+
+size_t BitmapStore::size() const
+{
+    return elementCount;
+}
+
+size_t BitmapStore::count(TraversalMode mode) const
+{
+    return mode == TraversalMode::Prime ? primeCount : elementCount;
+}
+
+int BitmapStore::at(TraversalMode mode, size_t index) const
+{
+    if (index >= count(mode))
+    {
+        throw out_of_range("Iterator out of range");
+    }
+
+    switch (mode)
+    {
+    case TraversalMode::Ascending:
+        return select(valueRanks, index, false);
+    case TraversalMode::SideCross:
+        return select(valueRanks, crossToAscending(index, elementCount), false);
+    case TraversalMode::Prime:
+        return select(primeRanks, index, true);
+    }
+
+    throw invalid_argument("Unknown traversal mode");
+}
+
+bool BitmapStore::contains(int element) const
+{
+    uint32_t key = toKey(element);
+    auto high = static_cast<uint16_t>(key >> 16);
+    auto it = findBucket(high);
+
+    return it != buckets.end() && it->high == high && it->values.contains(static_cast<uint16_t>(key));
+}
+
+void BitmapStore::insert(int element)
+{
+    uint32_t key = toKey(element);
+    auto high = static_cast<uint16_t>(key >> 16);
+    auto low = static_cast<uint16_t>(key);
+    auto it = findBucket(high);
+
+    // A new bucket shifts the prefix counts by one position, so they are rebuilt
+    if (it == buckets.end() || it->high != high)
+    {
+        Bucket &created = bucket(high);
+        created.values.insert(low);
+        if (isPrime(element))
+        {
+            created.primes.insert(low);
+        }
+        rebuildRanks();
+        return;
+    }
+
+    auto number = static_cast<size_t>(it - buckets.begin());
+    Bucket &target = buckets[number];
+    if (!target.values.insert(low))
+    {
+        return;
+    }
+
+    bool prime = isPrime(element);
+    if (prime)
+    {
+        target.primes.insert(low);
+    }
+    updateRanks(number, prime, true);
+}
+
+void BitmapStore::erase(int element)
+{
+    uint32_t key = toKey(element);
+    auto high = static_cast<uint16_t>(key >> 16);
+    auto low = static_cast<uint16_t>(key);
+    auto it = findBucket(high);
+
+    if (it == buckets.end() || it->high != high)
+    {
+        return;
+    }
+
+    auto number = static_cast<size_t>(it - buckets.begin());
+    Bucket &target = buckets[number];
+    if (!target.values.erase(low))
+    {
+        return;
+    }
+
+    bool prime = target.primes.erase(low);
+    if (target.values.cardinality() == 0)
+    {
+        rebuildRanks();
+        return;
+    }
+    updateRanks(number, prime, false);
+}
+
+void BitmapStore::applyBatch(const vector<int> &additions, const vector<int> &removals)
+{
+    for (int element : removals)
+    {
+        uint32_t key = toKey(element);
+        auto high = static_cast<uint16_t>(key >> 16);
+        auto it = findBucket(high);
+
+        if (it != buckets.end() && it->high == high)
+        {
+            Bucket &target = buckets[static_cast<size_t>(it - buckets.begin())];
+            if (target.values.erase(static_cast<uint16_t>(key)))
+            {
+                target.primes.erase(static_cast<uint16_t>(key));
+            }
+        }
+    }
+
+    vector<uint32_t> keys;
+    keys.reserve(additions.size());
+    transform(additions.begin(), additions.end(), back_inserter(keys), toKey);
+    sort(keys.begin(), keys.end());
+
+    for (size_t start = 0, end = 0; start < keys.size(); start = end)
+    {
+        auto high = static_cast<uint16_t>(keys[start] >> 16);
+        for (end = start; end < keys.size() && keys[end] >> 16 == high; ++end)
+        {
+        }
+
+        Bucket &target = bucket(high);
+        bool sieve = end - start >= SieveThreshold;
+
+        for (size_t index = start; index < end; ++index)
+        {
+            auto low = static_cast<uint16_t>(keys[index]);
+            if (target.values.insert(low) && !sieve && isPrime(fromKey(keys[index])))
+            {
+                target.primes.insert(low);
+            }
+        }
+
+        if (sieve && target.values.kind() == BitmapChunk::Kind::Bitmap)
+        {
+            vector<uint64_t> mask = primeMask(high);
+            target.primes.assignIntersection(target.values, mask.data());
+        }
+        else if (sieve)
+        {
+            for (size_t index = start; index < end; ++index)
+            {
+                if (isPrime(fromKey(keys[index])))
+                {
+                    target.primes.insert(static_cast<uint16_t>(keys[index]));
+                }
+            }
+        }
+    }
+
+    rebuildRanks();
+}
+
+void BitmapStore::assign(span<const int> sorted, span<const int> primes)
+{
+    buckets.clear();
+
+    vector<uint16_t> lows;
+    for (size_t start = 0, end = 0; start < sorted.size(); start = end)
+    {
+        auto high = static_cast<uint16_t>(toKey(sorted[start]) >> 16);
+        lows.clear();
+        for (end = start; end < sorted.size() && toKey(sorted[end]) >> 16 == high; ++end)
+        {
+            lows.push_back(static_cast<uint16_t>(toKey(sorted[end])));
+        }
+
+        buckets.push_back(Bucket{high, BitmapChunk(memory), BitmapChunk(memory)});
+        buckets.back().values.assign(lows);
+    }
+
+    for (size_t start = 0, end = 0; start < primes.size(); start = end)
+    {
+        auto high = static_cast<uint16_t>(toKey(primes[start]) >> 16);
+        lows.clear();
+        for (end = start; end < primes.size() && toKey(primes[end]) >> 16 == high; ++end)
+        {
+            lows.push_back(static_cast<uint16_t>(toKey(primes[end])));
+        }
+
+        bucket(high).primes.assign(lows);
+    }
+
+    rebuildRanks();
+}
+
+MemoryFootprint BitmapStore::memoryFootprint() const
+{
+    MemoryFootprint footprint;
+    footprint.overhead = {sizeof(BitmapStore), sizeof(BitmapStore)};
+    footprint.overhead += Footprint::of(buckets);
+    footprint.values = Footprint::of(valueRanks);
+    footprint.prime = Footprint::of(primeRanks);
+
+    for (const Bucket &bucket : buckets)
+    {
+        footprint.values += bucket.values.footprint();
+        footprint.prime += bucket.primes.footprint();
+    }
+
+    return footprint;
+}
+
+vector<uint64_t> BitmapStore::primeMask(uint16_t high)
+{
+    // Primes up to sqrt(2^31), enough to sieve the magnitude of any int
+    static const vector<int64_t> smallPrimes = []
+    {
+        const int64_t limit = 46341;
+        vector<bool> composite(static_cast<size_t>(limit) + 1, false);
+        vector<int64_t> found;
+        for (int64_t candidate = 2; candidate <= limit; ++candidate)
+        {
+            if (!composite[static_cast<size_t>(candidate)])
+            {
+                found.push_back(candidate);
+                for (int64_t multiple = candidate * candidate; multiple <= limit; multiple += candidate)
+                {
+                    composite[static_cast<size_t>(multiple)] = true;
+                }
+            }
+        }
+        return found;
+    }();
+
+    // A bucket holds 65536 consecutive elements of one sign, so their magnitudes are consecutive too
+    int64_t first = fromKey(static_cast<uint32_t>(high) << 16);
+    int64_t last = first + 65535;
+    int64_t lowest = first >= 0 ? first : -last;
+    int64_t highest = first >= 0 ? last : -first;
+
+    vector<bool> composite(65536, false);
+    for (int64_t prime : smallPrimes)
+    {
+        if (prime * prime > highest)
+        {
+            break;
+        }
+
+        for (int64_t multiple = max(prime * prime, (lowest + prime - 1) / prime * prime); multiple <= highest; multiple += prime)
+        {
+            composite[static_cast<size_t>(multiple - lowest)] = true;
+        }
+    }
+
+    vector<uint64_t> mask(BitmapChunk::BitmapWords, 0);
+    for (size_t low = 0; low < 65536; ++low)
+    {
+        int64_t magnitude = abs(first + static_cast<int64_t>(low));
+        if (magnitude >= 2 && !composite[static_cast<size_t>(magnitude - lowest)])
+        {
+            mask[low / 64] |= uint64_t{1} << (low % 64);
+        }
+    }
+
+    return mask;
+}
+
+pmr::vector<BitmapStore::Bucket>::const_iterator BitmapStore::findBucket(uint16_t high) const
+{
+    return lower_bound(buckets.begin(), buckets.end(), high, [](const Bucket &bucket, uint16_t h) { return bucket.high < h; });
+}
+
+BitmapStore::Bucket &BitmapStore::bucket(uint16_t high)
+{
+    auto it = buckets.begin() + (findBucket(high) - buckets.cbegin());
+
+    if (it == buckets.end() || it->high != high)
+    {
+        it = buckets.insert(it, Bucket{high, BitmapChunk(memory), BitmapChunk(memory)});
+    }
+
+    return *it;
+}
+
+void BitmapStore::rebuildRanks()
+{
+    buckets.erase(remove_if(buckets.begin(), buckets.end(), [](const Bucket &bucket) { return bucket.values.cardinality() == 0; }), buckets.end());
+
+    valueRanks.resize(buckets.size());
+    primeRanks.resize(buckets.size());
+    elementCount = 0;
+    primeCount = 0;
+
+    for (size_t index = 0; index < buckets.size(); ++index)
+    {
+        valueRanks[index] = elementCount;
+        primeRanks[index] = primeCount;
+        elementCount += buckets[index].values.cardinality();
+        primeCount += buckets[index].primes.cardinality();
+    }
+}
+
+void BitmapStore::updateRanks(size_t number, bool prime, bool added)
+{
+    // Only the buckets after the touched one move
+    for (size_t index = number + 1; index < buckets.size(); ++index)
+    {
+        valueRanks[index] = added ? valueRanks[index] + 1 : valueRanks[index] - 1;
+        if (prime)
+        {
+            primeRanks[index] = added ? primeRanks[index] + 1 : primeRanks[index] - 1;
+        }
+    }
+
+    elementCount = added ? elementCount + 1 : elementCount - 1;
+    if (prime)
+    {
+        primeCount = added ? primeCount + 1 : primeCount - 1;
+    }
+}
+
+int BitmapStore::select(const pmr::vector<size_t> &ranks, size_t index, bool primesOnly) const
+{
+    auto next = upper_bound(ranks.begin(), ranks.end(), index);
+    auto number = static_cast<size_t>(next - ranks.begin()) - 1;
+    const Bucket &found = buckets[number];
+    uint16_t low = (primesOnly ? found.primes : found.values).select(index - ranks[number]);
+
+    return fromKey(static_cast<uint32_t>(found.high) << 16 | low);
+}
+}
@@ -0,0 +1,270 @@
+#ifndef BITMAP_STORE_HPP
+#define BITMAP_STORE_HPP
+
+#include "ElementStore.hpp"
+
+#include <cstdint>
+
+namespace ariel
+{
+    /*
+     * @brief A set of 16-bit values in the smallest of three roaring layouts.
+     *
+     * Sparse sets are a sorted array, dense sets a 65536-bit bitmap with a rank table for popcount-based
+     * select, and sets made of long stretches a list of runs with the values before each run, so select
+     * is a binary search in every layout.
+     */
+    class BitmapChunk
+    {
+    public:
+        /*
+         * @brief The layouts a chunk can take.
+         */
+        enum class Kind : uint8_t
+        {
+            Array,      // Sorted values, up to ArrayLimit of them
+            Bitmap,     // One bit per possible value
+            Run         // Sorted, disjoint [first, last] ranges
+        };
+
+        static constexpr size_t ArrayLimit = 4096;      // Largest array before it becomes a bitmap
+        static constexpr size_t BitmapWords = 1024;     // 64-bit words of a bitmap
+        static constexpr size_t RankWords = 8;          // Words summarized by one rank table entry
+        static constexpr size_t RunLimit = 2048;        // Most runs before they become a bitmap
+
+        /*
+         * @brief Constructs an empty chunk allocating from a memory resource.
+         *
+         * @param resource The memory resource used for the chunk.
+         */
+        explicit BitmapChunk(std::pmr::memory_resource* resource);
+
+        /*
+         * @brief Copies another chunk into a memory resource.
+         *
+         * @param other The chunk to copy.
+         * @param resource The memory resource used for the copy.
+         */
+        BitmapChunk(const BitmapChunk& other, std::pmr::memory_resource* resource);
+
+        BitmapChunk(const BitmapChunk& other) = delete;
+        BitmapChunk(BitmapChunk&& other) noexcept = default;
+        BitmapChunk& operator=(const BitmapChunk& other) = delete;
+        BitmapChunk& operator=(BitmapChunk&& other) = default;
+        ~BitmapChunk() = default;
+
+        /*
+         * @brief Returns the layout of the chunk.
+         *
+         * @return The layout.
+         */
+        Kind kind() const;
+
+        /*
+         * @brief Returns the number of values.
+         *
+         * @return The number of values.
+         */
+        size_t cardinality() const;
+
+        /*
+         * @brief Checks if a value is in the chunk.
+         *
+         * @param value The value.
+         * @return True if the value is in the chunk.
+         */
+        bool contains(uint16_t value) const;
+
+        /*
+         * @brief Adds a value, switching layout if the current one becomes the larger one.
+         *
+         * @param value The value.
+         * @return True if the value was added, false if it was already there.
+         */
+        bool insert(uint16_t value);
+
+        /*
+         * @brief Removes a value, switching layout if the current one becomes the larger one.
+         *
+         * @param value The value.
+         * @return True if the value was removed, false if it was not there.
+         */
+        bool erase(uint16_t value);
+
+        /*
+         * @brief Returns the value with a given number of smaller values in the chunk.
+         *
+         * @param rank The rank, smaller than cardinality().
+         * @return The value.
+         */
+        uint16_t select(size_t rank) const;
+
+        /*
+         * @brief Replaces the values, picking the smallest layout for them.
+         *
+         * @param sorted The values, strictly ascending.
+         */
+        void assign(std::span<const uint16_t> sorted);
+
+        /*
+         * @brief Replaces the values with the intersection of a bitmap chunk and a mask, one word at a time.
+         *
+         * @param bitmap A chunk in the Bitmap layout.
+         * @param mask BitmapWords words to intersect with.
+         */
+        void assignIntersection(const BitmapChunk& bitmap, const uint64_t* mask);
+
+        /*
+         * @brief Measures the memory held by the chunk.
+         *
+         * @return The bytes of the current layout's buffers.
+         */
+        Footprint footprint() const;
+
+    private:
+        struct Run
+        {
+            uint16_t first;     // The first value of the run
+            uint16_t last;      // The last value of the run
+        };
+
+        Kind layout = Kind::Array;              // The current layout
+        uint32_t values = 0;                    // The number of values
+        std::pmr::vector<uint16_t> array;       // The values, in the Array layout
+        std::pmr::vector<uint64_t> words;       // The bits, in the Bitmap layout
+        std::pmr::vector<uint16_t> ranks;       // Values before every RankWords words, in the Bitmap layout
+        std::pmr::vector<Run> runs;             // The runs, in the Run layout
+        std::pmr::vector<uint16_t> runRanks;    // Values before every run, in the Run layout
+
+        /*
+         * @brief Switches to the Bitmap layout.
+         */
+        void toBitmap();
+
+        /*
+         * @brief Switches to the Array layout.
+         */
+        void toArray();
+
+        /*
+         * @brief Recomputes the rank table of the Bitmap layout.
+         */
+        void rebuildRanks();
+
+        /*
+         * @brief Recomputes the values before every run of the Run layout from one run onward.
+         *
+         * @param from The first run whose position or predecessors changed.
+         */
+        void rebuildRunRanks(size_t from);
+    };
+
+    /*
+     * @brief A backend for dense integer sets, in the style of roaring bitmaps.
+     *
+     * The elements are split by the high 16 bits of their key into buckets. Each bucket holds a chunk of
+     * the low 16 bits of its elements and a second chunk of the low bits of its prime elements. Prefix counts
+     * over the buckets turn a traversal position into a bucket and a rank, and the chunk's select finishes
+     * the lookup. Prime chunks of dense buckets are built by intersecting the bitmap with a sieved prime mask.
+     */
+    class BitmapStore : public ElementStore
+    {
+    public:
+        /*
+         * @brief Constructs an empty store allocating from a memory resource.
+         *
+         * @param resource The memory resource used for every structure of the store.
+         */
+        explicit BitmapStore(std::pmr::memory_resource* resource);
+
+        /*
+         * @brief Copies another store into the same memory resource.
+         *
+         * @param other The store to copy.
+         */
+        BitmapStore(const BitmapStore& other);
+
+        BitmapStore(BitmapStore&& other) = delete;
+        BitmapStore& operator=(const BitmapStore& other) = delete;
+        BitmapStore& operator=(BitmapStore&& other) = delete;
+        ~BitmapStore() override = default;
+
+        std::shared_ptr<ElementStore> clone() const override;
+        StorageBackend backend() const override;
+        std::pmr::memory_resource* resource() const override;
+        size_t size() const override;
+        size_t count(TraversalMode mode) const override;
+        int at(TraversalMode mode, size_t index) const override;
+        bool contains(int element) const override;
+        void insert(int element) override;
+        void erase(int element) override;
+        void applyBatch(const std::vector<int>& additions, const std::vector<int>& removals) override;
+        void assign(std::span<const int> sorted, std::span<const int> primes) override;
+        MemoryFootprint memoryFootprint() const override;
+
+        /*
+         * @brief Computes which of the 65536 elements of a bucket are prime, with a segmented sieve.
+         *
+         * @param high The high 16 bits of the bucket's keys.
+         * @return BitmapChunk::BitmapWords words, bit i set if the element with low bits i is prime.
+         */
+        static std::vector<uint64_t> primeMask(uint16_t high);
+
+    private:
+        struct Bucket
+        {
+            uint16_t high;          // The high 16 bits of the keys in the bucket
+            BitmapChunk values;     // The low 16 bits of the elements
+            BitmapChunk primes;     // The low 16 bits of the prime elements
+        };
+
+        std::pmr::memory_resource* memory;      // The memory resource of the store
+        std::pmr::vector<Bucket> buckets;       // The buckets, ascending by high bits
+        std::pmr::vector<size_t> valueRanks;    // Elements in the buckets before each bucket
+        std::pmr::vector<size_t> primeRanks;    // Prime elements in the buckets before each bucket
+        size_t elementCount = 0;                // The number of elements
+        size_t primeCount = 0;                  // The number of prime elements
+
+        /*
+         * @brief Finds the bucket of a key's high bits.
+         *
+         * @param high The high 16 bits.
+         * @return The first bucket whose high bits are not smaller.
+         */
+        std::pmr::vector<Bucket>::const_iterator findBucket(uint16_t high) const;
+
+        /*
+         * @brief Finds the bucket of a key's high bits, creating it if needed.
+         *
+         * @param high The high 16 bits.
+         * @return The bucket.
+         */
+        Bucket& bucket(uint16_t high);
+
+        /*
+         * @brief Drops empty buckets and recomputes the prefix counts.
+         */
+        void rebuildRanks();
+
+        /*
+         * @brief Updates the prefix counts after one element of an existing bucket was added or removed.
+         *
+         * @param number The position of the bucket.
+         * @param prime True if the element is prime.
+         * @param added True if the element was added, false if it was removed.
+         */
+        void updateRanks(size_t number, bool prime, bool added);
+
+        /*
+         * @brief Returns the element at a position of an ascending order held by one chunk per bucket.
+         *
+         * @param ranks The prefix counts of the order.
+         * @param index The position.
+         * @param primesOnly True for the prime chunks, false for the element chunks.
+         * @return The element.
+         */
+        int select(const std::pmr::vector<size_t>& ranks, size_t index, bool primesOnly) const;
+    };
+}
+
+#endif
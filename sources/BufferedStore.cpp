@@ -0,0 +1,124 @@
+#include "BufferedStore.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+
+namespace ariel{
+BufferedStore::BufferedStore(pmr::memory_resource *resource)
+    : pending(resource) {}
+
+BufferedStore::BufferedStore(const BufferedStore &other)
+    : ElementStore(other), pending(other.pending.get_allocator().resource())
+{
+    // Readers of the source may be settling it right now, so the derived class copies it settled
+    other.commit();
+    elementCount = other.elementCount;
+}
+
+size_t BufferedStore::size() const
+{
+    return elementCount;
+}
+
+bool BufferedStore::contains(int element) const
+{
+    // A dirty store may be committed by another reader at any moment, so look it up under the lock
+    if (dirty.load(memory_order_acquire))
+    {
+        lock_guard<mutex> lock(readMutex);
+        if (dirty.load(memory_order_relaxed))
+        {
+            auto it = pending.find(element);
+            if (it != pending.end())
+            {
+                return it->second;
+            }
+        }
+
+        return containsCommitted(element);
+    }
+
+    return containsCommitted(element);
+}
+
+void BufferedStore::insert(int element)
+{
+    if (contains(element))
+    {
+        return;
+    }
+
+    // Recorded only; the next read merges the whole burst at once
+    pending[element] = true;
+    ++elementCount;
+    dirty.store(true, memory_order_relaxed);
+}
+
+void BufferedStore::erase(int element)
+{
+    if (!contains(element))
+    {
+        return;
+    }
+
+    pending[element] = false;
+    --elementCount;
+    dirty.store(true, memory_order_relaxed);
+}
+
+void BufferedStore::applyBatch(const vector<int> &additions, const vector<int> &removals)
+{
+    vector<int> added(additions), removed(removals);
+    sort(added.begin(), added.end());
+    added.erase(unique(added.begin(), added.end()), added.end());
+    sort(removed.begin(), removed.end());
+    removed.erase(unique(removed.begin(), removed.end()), removed.end());
+
+    commit();
+    elementCount = merge(added, removed);
+}
+
+void BufferedStore::commit() const
+{
+    if (!dirty.load(memory_order_acquire))
+    {
+        return;
+    }
+
+    lock_guard<mutex> lock(readMutex);
+    if (!dirty.load(memory_order_relaxed))
+    {
+        return;
+    }
+
+    // The last operation on every element wins, as if the operations had been applied one by one
+    vector<int> added, removed;
+    for (const auto &[element, present] : pending)
+    {
+        (present ? added : removed).push_back(element);
+    }
+    sort(added.begin(), added.end());
+    sort(removed.begin(), removed.end());
+
+    merge(added, removed);
+    pending.clear();
+    dirty.store(false, memory_order_release);
+}
+
+void BufferedStore::discardPending(size_t elements)
+{
+    pending.clear();
+    dirty.store(false, memory_order_relaxed);
+    elementCount = elements;
+}
+
+Footprint BufferedStore::pendingFootprint() const
+{
+    // Every entry is a node of its own, holding the next pointer and the pair; the buckets are one pointer each
+    size_t node = sizeof(void *) + sizeof(pair<const int, bool>);
+    size_t buckets = pending.bucket_count() * sizeof(void *);
+    return {pending.size() * node, pending.size() * node + buckets};
+}
+}
@@ -0,0 +1,89 @@
+#ifndef BUFFERED_STORE_HPP
+#define BUFFERED_STORE_HPP
+
+#include "ElementStore.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+namespace ariel
+{
+    /*
+     * @brief A store that records single additions and removals and merges them in bursts.
+     *
+     * insert() and erase() only record the modification. The next read that needs the committed structures
+     * calls commit(), which hands the whole burst to merge() at once, so k modifications followed by a read
+     * cost one merge instead of k. Readers sharing a snapshot may commit it concurrently; the first one does.
+     */
+    class BufferedStore : public ElementStore
+    {
+    public:
+        /*
+         * @brief Constructs an empty store whose buffer allocates from a memory resource.
+         *
+         * @param resource The memory resource used for the buffered modifications.
+         */
+        explicit BufferedStore(std::pmr::memory_resource* resource);
+
+        /*
+         * @brief Copies the element count of another store, committing that store first.
+         *
+         * @param other The store to copy. Its committed structures are then copied by the derived class.
+         */
+        BufferedStore(const BufferedStore& other);
+
+        BufferedStore(BufferedStore&& other) = delete;
+        BufferedStore& operator=(const BufferedStore& other) = delete;
+        BufferedStore& operator=(BufferedStore&& other) = delete;
+        ~BufferedStore() override = default;
+
+        size_t size() const override;
+        bool contains(int element) const override;
+        void insert(int element) override;
+        void erase(int element) override;
+        void applyBatch(const std::vector<int>& additions, const std::vector<int>& removals) override;
+        void commit() const override;
+
+    protected:
+        mutable std::mutex readMutex;   // Serializes readers committing the store or building a derived structure
+        size_t elementCount = 0;        // The number of elements, buffered modifications included
+
+        /*
+         * @brief Checks if an element is in the committed structures, ignoring the buffer.
+         *
+         * @param element The element to look for.
+         * @return True if the element is committed.
+         */
+        virtual bool containsCommitted(int element) const = 0;
+
+        /*
+         * @brief Merges sorted additions and removals into the committed structures.
+         *
+         * @param added The elements to add, strictly ascending.
+         * @param removed The elements to remove, strictly ascending; an element also in added stays.
+         * @return The number of committed elements after the merge.
+         */
+        virtual size_t merge(const std::vector<int>& added, const std::vector<int>& removed) const = 0;
+
+        /*
+         * @brief Drops the buffered modifications, for a store whose contents are replaced as a whole.
+         *
+         * @param elements The number of elements of the new contents.
+         */
+        void discardPending(size_t elements);
+
+        /*
+         * @brief Estimates the memory held by the buffered modifications. The caller holds readMutex.
+         *
+         * @return The bytes of the buffer's nodes and buckets.
+         */
+        Footprint pendingFootprint() const;
+
+    private:
+        mutable std::pmr::unordered_map<int, bool> pending;     // Modifications since the last commit: true to add, false to remove
+        mutable std::atomic<bool> dirty{false};                 // True while pending holds modifications
+    };
+}
+
+#endif
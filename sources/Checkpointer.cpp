@@ -0,0 +1,356 @@
+#include "Checkpointer.hpp"
+#include "ContainerFile.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+namespace ariel{
+static const string ManifestName = "CHECKPOINT";    // The file naming the oldest log not covered by the blocks
+static const string TemporarySuffix = ".tmp";       // Files being written by ContainerFile::writeFile, renamed into place once complete
+
+/*
+ * @brief Finds the positions of an order whose elements fall in a block.
+ */
+static pair<size_t, size_t> blockPositions(const MagicalContainer &container, TraversalMode mode, uint32_t block)
+{
+    size_t first = container.rank(mode, ElementStore::fromKey(block << Checkpointer::BlockBits));
+    size_t last = container.rank(mode, ElementStore::fromKey(((block + 1) << Checkpointer::BlockBits) - 1), true);
+    return {first, last};
+}
+
+/*
+ * @brief Parses a whole string as an unsigned number.
+ */
+template <typename Number>
+static bool parseNumber(const string &text, Number &number, int base)
+{
+    auto [stop, error] = from_chars(text.data(), text.data() + text.size(), number, base);
+    return !text.empty() && error == errc() && stop == text.data() + text.size();
+}
+
+/*
+ * @brief Parses the name of a block file, block-XXXX.mgcf.
+ */
+static bool parseBlockName(const string &name, uint32_t &block)
+{
+    return name.size() == 15 && name.starts_with("block-") && name.ends_with(".mgcf")
+           && parseNumber(name.substr(6, 4), block, 16);
+}
+
+/*
+ * @brief Flushes the entries of a directory to the disk.
+ */
+static void syncDirectory(const string &directory)
+{
+    int descriptor = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (descriptor < 0)
+    {
+        throw runtime_error("Error: cannot open " + directory);
+    }
+
+    bool synced = fsync(descriptor) == 0;
+    close(descriptor);
+    if (!synced)
+    {
+        throw runtime_error("Error: cannot sync " + directory);
+    }
+}
+
+Checkpointer::Checkpointer(MagicalContainer &container, const string &directory, WriteAheadLog::SyncPolicy sync,
+                           size_t groupSize)
+    : container(container), directory(directory), sync(sync), groupSize(groupSize), dirty(BlockCount)
+{
+    filesystem::create_directories(directory);
+
+    uint64_t covered = 0;
+    if (filesystem::exists(pathOf(ManifestName)))
+    {
+        ifstream manifest(pathOf(ManifestName));
+        if (!(manifest >> covered))
+        {
+            throw runtime_error("Error: corrupt checkpoint manifest");
+        }
+    }
+
+    vector<uint32_t> blocks;
+    vector<uint64_t> logs;
+    for (const auto &entry : filesystem::directory_iterator(directory))
+    {
+        string name = entry.path().filename().string();
+        uint32_t block = 0;
+        uint64_t generation = 0;
+
+        if (name.ends_with(TemporarySuffix))
+        {
+            // Left behind by a checkpoint that never completed
+            filesystem::remove(entry.path());
+        }
+        else if (parseBlockName(name, block))
+        {
+            blocks.push_back(block);
+        }
+        else if (name.starts_with("log-") && name.ends_with(".wal")
+                 && parseNumber(name.substr(4, name.size() - 8), generation, 10))
+        {
+            logs.push_back(generation);
+        }
+    }
+    sort(blocks.begin(), blocks.end());
+    sort(logs.begin(), logs.end());
+
+    // Blocks cover consecutive value ranges, so their elements concatenate into the ascending order
+    vector<int> sorted, primes, blockSorted, blockPrimes;
+    for (uint32_t block : blocks)
+    {
+        ContainerFile::decode(ContainerFile::readFile(blockPath(block)), blockSorted, blockPrimes);
+        if (blockSorted.empty() || ElementStore::toKey(blockSorted.front()) >> BlockBits != block
+            || ElementStore::toKey(blockSorted.back()) >> BlockBits != block)
+        {
+            throw runtime_error("Error: corrupt checkpoint block " + blockPath(block));
+        }
+        sorted.insert(sorted.end(), blockSorted.begin(), blockSorted.end());
+        primes.insert(primes.end(), blockPrimes.begin(), blockPrimes.end());
+    }
+    container.replace(sorted, primes);
+
+    // Logs older than the manifest are covered by the blocks; the others are replayed in order
+    logGeneration = covered;
+    for (uint64_t generation : logs)
+    {
+        if (generation < covered)
+        {
+            filesystem::remove(logPath(generation));
+            continue;
+        }
+
+        rewriteAll = rewriteAll || filesystem::file_size(logPath(generation)) > WriteAheadLog::HeaderSize;
+        if (generation != logs.back())
+        {
+            WriteAheadLog::replay(container, logPath(generation));
+        }
+        logGeneration = generation;
+    }
+
+    log = make_unique<WriteAheadLog>(container, logPath(logGeneration), sync, groupSize);
+}
+
+Checkpointer::~Checkpointer()
+{
+    // The background checkpoint reads this object, so it has to finish first
+    if (running.valid())
+    {
+        running.wait();
+    }
+}
+
+void Checkpointer::addElement(int element)
+{
+    log->addElement(element);
+    touch(element);
+}
+
+void Checkpointer::removeElement(int element)
+{
+    log->removeElement(element);
+    touch(element);
+}
+
+void Checkpointer::commit()
+{
+    log->commit();
+}
+
+shared_future<size_t> Checkpointer::startCheckpoint()
+{
+    if (running.valid())
+    {
+        running.wait();
+    }
+    if (failed.exchange(false))
+    {
+        rewriteAll = true;
+    }
+
+    // Everything logged so far is in the snapshot; everything after it goes to the next log
+    log->commit();
+    auto next = make_unique<WriteAheadLog>(container, logPath(logGeneration + 1), sync, groupSize);
+
+    // The snapshot shares the whole store, so the first modification while the checkpoint runs copies all of
+    // it, not only its block. That is deliberate: the stores have no per-block sharing, and the copy is the
+    // same one any snapshot reader causes. The snapshot is released as soon as the blocks are written
+    MagicalContainer snapshot = container.snapshot();
+
+    vector<uint32_t> blocks;
+    if (!rewriteAll)
+    {
+        blocks.reserve(dirtyCount);
+        for (uint32_t block = 0; block < BlockCount; ++block)
+        {
+            if (dirty[block])
+            {
+                blocks.push_back(block);
+            }
+        }
+    }
+
+    bool everyBlock = rewriteAll;
+    log = move(next);
+    ++logGeneration;
+    dirty.assign(BlockCount, false);
+    dirtyCount = 0;
+    rewriteAll = false;
+
+    uint64_t generation = logGeneration;
+    running = async(launch::async, [this, snapshot = move(snapshot), blocks = move(blocks), everyBlock, generation]() mutable
+                    {
+                        // The shared state keeps this task until the next checkpoint, so the snapshot is taken out of
+                        // it and released as soon as the blocks are written; otherwise every first modification
+                        // after a checkpoint would copy the whole store
+                        MagicalContainer taken = move(snapshot);
+                        try
+                        {
+                            return write(taken, move(blocks), everyBlock, generation);
+                        }
+                        catch (...)
+                        {
+                            failed.store(true);
+                            throw;
+                        }
+                    }).share();
+    return running;
+}
+
+size_t Checkpointer::checkpoint()
+{
+    return startCheckpoint().get();
+}
+
+size_t Checkpointer::dirtyBlocks() const
+{
+    return dirtyCount;
+}
+
+uint64_t Checkpointer::generation() const
+{
+    return logGeneration;
+}
+
+void Checkpointer::touch(int element)
+{
+    uint32_t block = ElementStore::toKey(element) >> BlockBits;
+    if (!dirty[block])
+    {
+        dirty[block] = true;
+        ++dirtyCount;
+    }
+}
+
+size_t Checkpointer::write(const MagicalContainer &snapshot, vector<uint32_t> blocks, bool everyBlock,
+                           uint64_t generation) const
+{
+    bool durable = sync != WriteAheadLog::SyncPolicy::None;
+
+    // Every block holding elements now or on the disk, found by jumping from block to block
+    if (everyBlock)
+    {
+        for (const auto &entry : filesystem::directory_iterator(directory))
+        {
+            string name = entry.path().filename().string();
+            uint32_t block = 0;
+            if (parseBlockName(name, block))
+            {
+                blocks.push_back(block);
+            }
+        }
+
+        size_t count = snapshot.count(TraversalMode::Ascending);
+        for (size_t position = 0; position < count;)
+        {
+            uint32_t block = ElementStore::toKey(snapshot.at(TraversalMode::Ascending, position)) >> BlockBits;
+            blocks.push_back(block);
+            position = blockPositions(snapshot, TraversalMode::Ascending, block).second;
+        }
+
+        sort(blocks.begin(), blocks.end());
+        blocks.erase(unique(blocks.begin(), blocks.end()), blocks.end());
+    }
+
+    vector<int> sorted, primes;
+    for (uint32_t block : blocks)
+    {
+        auto [first, last] = blockPositions(snapshot, TraversalMode::Ascending, block);
+        if (first == last)
+        {
+            filesystem::remove(blockPath(block));
+            continue;
+        }
+
+        auto [firstPrime, lastPrime] = blockPositions(snapshot, TraversalMode::Prime, block);
+        sorted.clear();
+        primes.clear();
+        for (size_t position = first; position < last; ++position)
+        {
+            sorted.push_back(snapshot.at(TraversalMode::Ascending, position));
+        }
+        for (size_t position = firstPrime; position < lastPrime; ++position)
+        {
+            primes.push_back(snapshot.at(TraversalMode::Prime, position));
+        }
+
+        ContainerFile::writeFile(blockPath(block), ContainerFile::encode(sorted, primes), durable);
+    }
+
+    // The blocks must be in place before the manifest stops covering the old logs
+    if (durable)
+    {
+        syncDirectory(directory);
+    }
+
+    string manifest = to_string(generation) + "\n";
+    ContainerFile::writeFile(pathOf(ManifestName), span(reinterpret_cast<const uint8_t *>(manifest.data()), manifest.size()),
+                             durable);
+    if (durable)
+    {
+        syncDirectory(directory);
+    }
+
+    for (const auto &entry : filesystem::directory_iterator(directory))
+    {
+        string name = entry.path().filename().string();
+        uint64_t older = 0;
+        if (name.starts_with("log-") && name.ends_with(".wal") && parseNumber(name.substr(4, name.size() - 8), older, 10)
+            && older < generation)
+        {
+            filesystem::remove(entry.path());
+        }
+    }
+
+    return blocks.size();
+}
+
+string Checkpointer::pathOf(const string &name) const
+{
+    return (filesystem::path(directory) / name).string();
+}
+
+string Checkpointer::logPath(uint64_t generation) const
+{
+    return pathOf("log-" + to_string(generation) + ".wal");
+}
+
+string Checkpointer::blockPath(uint32_t block) const
+{
+    char name[16];
+    snprintf(name, sizeof(name), "block-%04x.mgcf", block);
+    return pathOf(name);
+}
+}
@@ -0,0 +1,162 @@
+#ifndef CHECKPOINTER_HPP
+#define CHECKPOINTER_HPP
+
+#include "MagicalContainer.hpp"
+#include "WriteAheadLog.hpp"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ariel
+{
+    /*
+     * @brief Keeps a container durable in a directory of blocks and write-ahead logs.
+     *
+     * The value range is split into blocks of 2^BlockBits consecutive keys (ElementStore::toKey), and every
+     * block holding elements is saved as its own container file. Modifications go through a write-ahead log
+     * and mark their block dirty. A checkpoint takes a copy-on-write snapshot of the container, switches to a
+     * new log and writes only the dirty blocks from the snapshot on a background thread. Once the blocks are
+     * on the disk the manifest moves to the new log and the older logs are deleted, so checkpoints write in
+     * proportion to the churn, not to the size of the container.
+     *
+     * Copy-on-write works on the whole store, not per block: the first modification while a checkpoint is
+     * running copies the entire container once. Later modifications, and those after the checkpoint, copy
+     * nothing.
+     *
+     * The directory holds:
+     *   CHECKPOINT          the generation of the oldest log not covered by the blocks
+     *   block-XXXX.mgcf     the elements of block XXXX (hexadecimal), Delta encoded
+     *   log-N.wal           the write-ahead log of generation N
+     */
+    class Checkpointer
+    {
+    public:
+        static constexpr unsigned int BlockBits = 16;                      // Low key bits shared within a block
+        static constexpr size_t BlockCount = size_t{1} << (32 - BlockBits);  // Blocks covering every int
+
+        /*
+         * @brief Opens or creates a directory and recovers the container from it.
+         *
+         * The contents of the container are replaced by the saved blocks, then the logs are replayed. After a
+         * recovery that replayed any record, the first checkpoint rewrites every block.
+         *
+         * @param container The container. It must outlive the checkpointer.
+         * @param directory The directory, created if missing.
+         * @param sync When written log groups are flushed to the disk.
+         * @param groupSize Log records buffered before a group is written without a call to commit().
+         * @throws std::runtime_error If the directory cannot be used or holds damaged files.
+         */
+        Checkpointer(MagicalContainer& container, const std::string& directory,
+                     WriteAheadLog::SyncPolicy sync = WriteAheadLog::SyncPolicy::Commit,
+                     size_t groupSize = WriteAheadLog::GroupSize);
+
+        /*
+         * @brief Waits for a running checkpoint and writes the buffered log records.
+         */
+        ~Checkpointer();
+
+        Checkpointer(const Checkpointer& other) = delete;
+        Checkpointer(Checkpointer&& other) = delete;
+        Checkpointer& operator=(const Checkpointer& other) = delete;
+        Checkpointer& operator=(Checkpointer&& other) = delete;
+
+        /*
+         * @brief Adds an element to the container through the log.
+         *
+         * @param element The element to add.
+         * @throws std::runtime_error If the log cannot be written.
+         */
+        void addElement(int element);
+
+        /*
+         * @brief Removes an element from the container through the log.
+         *
+         * @param element The element to remove.
+         * @throws std::runtime_error If the log cannot be written.
+         */
+        void removeElement(int element);
+
+        /*
+         * @brief Writes the buffered log records as one group.
+         *
+         * @throws std::runtime_error If the log cannot be written.
+         */
+        void commit();
+
+        /*
+         * @brief Starts a checkpoint of the dirty blocks on a background thread.
+         *
+         * A checkpoint still running is waited for first. The container may be modified while the new one
+         * runs. If a checkpoint fails its logs are kept, and the next one rewrites every block.
+         *
+         * @return The number of blocks the checkpoint writes or deletes, available once it is done.
+         * @throws std::runtime_error If the log cannot be written or switched.
+         */
+        std::shared_future<size_t> startCheckpoint();
+
+        /*
+         * @brief Runs a checkpoint of the dirty blocks and waits for it.
+         *
+         * @return The number of blocks written or deleted.
+         * @throws std::runtime_error If the checkpoint fails.
+         */
+        size_t checkpoint();
+
+        /*
+         * @brief Gets the number of blocks modified since the last checkpoint started.
+         *
+         * @return The number of dirty blocks.
+         */
+        size_t dirtyBlocks() const;
+
+        /*
+         * @brief Gets the generation of the log being written.
+         *
+         * @return The generation, which grows by one with every checkpoint.
+         */
+        uint64_t generation() const;
+
+    private:
+        MagicalContainer& container;                // The container kept durable
+        std::string directory;                      // The directory of the blocks and logs
+        WriteAheadLog::SyncPolicy sync;             // When written log groups are flushed to the disk
+        size_t groupSize;                           // Log records per group
+        uint64_t logGeneration = 0;                 // The generation of the log being written
+        std::unique_ptr<WriteAheadLog> log;         // The log being written
+        std::vector<bool> dirty;                    // Bit b set if block b changed since the last checkpoint
+        size_t dirtyCount = 0;                      // The number of set bits in dirty
+        bool rewriteAll = false;                    // True if the next checkpoint must write every block
+        std::atomic<bool> failed{false};            // Set by a background checkpoint that failed
+        std::shared_future<size_t> running;         // The last checkpoint started, if any
+
+        /*
+         * @brief Marks the block of an element dirty.
+         */
+        void touch(int element);
+
+        /*
+         * @brief Writes blocks of a snapshot, or every block, then moves the manifest to a generation and deletes older logs.
+         */
+        size_t write(const MagicalContainer& snapshot, std::vector<uint32_t> blocks, bool everyBlock, uint64_t generation) const;
+
+        /*
+         * @brief Gets the path of a file in the directory.
+         */
+        std::string pathOf(const std::string& name) const;
+
+        /*
+         * @brief Gets the path of the log of a generation.
+         */
+        std::string logPath(uint64_t generation) const;
+
+        /*
+         * @brief Gets the path of the file of a block.
+         */
+        std::string blockPath(uint32_t block) const;
+    };
+}
+
+#endif
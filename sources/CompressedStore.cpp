@@ -0,0 +1,276 @@
+#include "CompressedStore.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+#include <mutex>
+
+using namespace std;
+
+
+namespace ariel{
+PackedBlocks::PackedBlocks(pmr::memory_resource *resource)
+    : blocks(resource), words(resource) {}
+
+PackedBlocks::PackedBlocks(const PackedBlocks &other, pmr::memory_resource *resource)
+    : blocks(other.blocks, resource), words(other.words, resource), keys(other.keys) {}
+
+void PackedBlocks::assign(span<const uint32_t> sorted)
+{
+    blocks.clear();
+    words.clear();
+    keys = sorted.size();
+
+    blocks.reserve((keys + BlockSize - 1) / BlockSize);
+
+    for (size_t start = 0; start < keys; start += BlockSize)
+    {
+        span<const uint32_t> block = sorted.subspan(start, min(BlockSize, keys - start));
+        auto width = static_cast<uint8_t>(bit_width(block.back() - block.front()));
+
+        blocks.push_back({block.front(), static_cast<uint32_t>(words.size()), width});
+        words.resize(words.size() + (block.size() * width + 63) / 64, 0);
+
+        if (width == 0)
+        {
+            continue;
+        }
+
+        uint64_t *packed = words.data() + blocks.back().offset;
+        for (size_t index = 0; index < block.size(); ++index)
+        {
+            uint64_t delta = block[index] - block.front();
+            size_t bit = index * width;
+
+            packed[bit / 64] |= delta << (bit % 64);
+            if (bit % 64 + width > 64)
+            {
+                packed[bit / 64 + 1] |= delta >> (64 - bit % 64);
+            }
+        }
+    }
+
+    blocks.shrink_to_fit();
+    words.shrink_to_fit();
+}
+
+size_t PackedBlocks::size() const
+{
+    return keys;
+}
+
+uint32_t PackedBlocks::at(size_t index) const
+{
+    const Block &block = blocks[index / BlockSize];
+
+    if (block.width == 0)
+    {
+        return block.first;
+    }
+
+    const uint64_t *packed = words.data() + block.offset;
+    size_t bit = (index % BlockSize) * block.width;
+    uint64_t delta = packed[bit / 64] >> (bit % 64);
+
+    if (bit % 64 + block.width > 64)
+    {
+        delta |= packed[bit / 64 + 1] << (64 - bit % 64);
+    }
+
+    delta &= (uint64_t{1} << block.width) - 1;
+    return block.first + static_cast<uint32_t>(delta);
+}
+
+size_t PackedBlocks::lowerBound(uint32_t key) const
+{
+    // The skip index finds the last block starting at or before the key, then the block is searched
+    auto next = upper_bound(blocks.begin(), blocks.end(), key, [](uint32_t k, const Block &block) { return k < block.first; });
+
+    if (next == blocks.begin())
+    {
+        return 0;
+    }
+
+    auto number = static_cast<size_t>(next - blocks.begin()) - 1;
+    size_t low = number * BlockSize, high = min(keys, low + BlockSize);
+
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (at(middle) < key)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+Footprint PackedBlocks::footprint() const
+{
+    Footprint bytes = Footprint::of(blocks);
+    bytes += Footprint::of(words);
+    return bytes;
+}
+
+CompressedStore::CompressedStore(pmr::memory_resource *resource)
+    : BufferedStore(resource), memory(resource), values(resource), primePositions(resource) {}
+
+CompressedStore::CompressedStore(const CompressedStore &other)
+    : BufferedStore(other), memory(other.memory), values(other.values, memory), primePositions(other.primePositions, memory) {}
+
+shared_ptr<ElementStore> CompressedStore::clone() const
+{
+    return allocate_shared<CompressedStore>(pmr::polymorphic_allocator<CompressedStore>(memory), *this);
+}
+
+StorageBackend CompressedStore::backend() const
+{
+    return StorageBackend::Compressed;
+}
+
+pmr::memory_resource *CompressedStore::resource() const
+{
+    return memory;
+}
+
+size_t CompressedStore::count(TraversalMode mode) const
+{
+    if (mode == TraversalMode::Prime)
+    {
+        commit();
+        return primePositions.size();
+    }
+
+    return elementCount;
+}
+
+int CompressedStore::at(TraversalMode mode, size_t index) const
+{
+    commit();
+    if (index >= count(mode))
+    {
+        throw out_of_range("Iterator out of range");
+    }
+
+    switch (mode)
+    {
+    case TraversalMode::Ascending:
+        return fromKey(values.at(index));
+    case TraversalMode::SideCross:
+        return fromKey(values.at(crossToAscending(index, values.size())));
+    case TraversalMode::Prime:
+        return fromKey(values.at(primePositions.at(index)));
+    }
+
+    throw invalid_argument("Unknown traversal mode");
+}
+
+bool CompressedStore::containsCommitted(int element) const
+{
+    size_t position = values.lowerBound(toKey(element));
+    return position < values.size() && values.at(position) == toKey(element);
+}
+
+size_t CompressedStore::merge(const vector<int> &added, const vector<int> &removed) const
+{
+    // Keys follow the order of the elements, so one pass merges the keys and carries the prime flags along
+    vector<uint32_t> keys, positions;
+    keys.reserve(values.size() + added.size());
+    positions.reserve(primePositions.size());
+
+    auto emit = [&keys, &positions](uint32_t key, bool prime)
+    {
+        if (prime)
+        {
+            positions.push_back(static_cast<uint32_t>(keys.size()));
+        }
+        keys.push_back(key);
+    };
+
+    size_t prime = 0;
+    auto it_added = added.begin(), it_removed = removed.begin();
+    for (size_t position = 0; position < values.size(); ++position)
+    {
+        uint32_t key = values.at(position);
+        bool isPrimeElement = prime < primePositions.size() && primePositions.at(prime) == position;
+        prime += isPrimeElement ? 1U : 0U;
+
+        int element = fromKey(key);
+        for (; it_added != added.end() && *it_added < element; ++it_added)
+        {
+            emit(toKey(*it_added), isPrime(*it_added));
+        }
+
+        bool readded = it_added != added.end() && *it_added == element;
+        it_added += readded ? 1 : 0;
+        while (it_removed != removed.end() && *it_removed < element)
+        {
+            ++it_removed;
+        }
+        if (!readded && it_removed != removed.end() && *it_removed == element)
+        {
+            continue;
+        }
+
+        emit(key, isPrimeElement);
+    }
+
+    for (; it_added != added.end(); ++it_added)
+    {
+        emit(toKey(*it_added), isPrime(*it_added));
+    }
+
+    if (keys.size() > numeric_limits<uint32_t>::max())
+    {
+        throw length_error("Too many elements for 32-bit positions");
+    }
+
+    values.assign(keys);
+    primePositions.assign(positions);
+    return values.size();
+}
+
+void CompressedStore::assign(span<const int> sorted, span<const int> primes)
+{
+    discardPending(sorted.size());
+
+    vector<uint32_t> keys;
+    vector<uint32_t> positions;
+    keys.reserve(sorted.size());
+    positions.reserve(primes.size());
+
+    auto it_prime = primes.begin();
+    for (size_t index = 0; index < sorted.size(); ++index)
+    {
+        keys.push_back(toKey(sorted[index]));
+
+        if (it_prime != primes.end() && *it_prime == sorted[index])
+        {
+            positions.push_back(static_cast<uint32_t>(index));
+            ++it_prime;
+        }
+    }
+
+    values.assign(keys);
+    primePositions.assign(positions);
+}
+
+MemoryFootprint CompressedStore::memoryFootprint() const
+{
+    // A burst not merged yet is measured in the buffer rather than merged by this call
+    lock_guard<mutex> lock(readMutex);
+    MemoryFootprint footprint;
+    footprint.values = values.footprint();
+    footprint.prime = primePositions.footprint();
+    footprint.overhead = {sizeof(CompressedStore), sizeof(CompressedStore)};
+    footprint.overhead += pendingFootprint();
+    return footprint;
+}
+}
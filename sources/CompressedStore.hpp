@@ -0,0 +1,139 @@
+#ifndef COMPRESSED_STORE_HPP
+#define COMPRESSED_STORE_HPP
+
+#include "BufferedStore.hpp"
+
+#include <cstdint>
+
+namespace ariel
+{
+    /*
+     * @brief A strictly ascending sequence of unsigned keys, bit-packed in fixed-size blocks.
+     *
+     * Every block stores its first key and the offsets of the other keys from it, using just enough bits
+     * for the largest offset. The first keys double as a skip index for searching, and any position can be
+     * decoded on its own, without unpacking the rest of its block.
+     */
+    class PackedBlocks
+    {
+    public:
+        static constexpr size_t BlockSize = 128;    // Keys per block
+
+        /*
+         * @brief Constructs an empty sequence allocating from a memory resource.
+         *
+         * @param resource The memory resource used for the blocks.
+         */
+        explicit PackedBlocks(std::pmr::memory_resource* resource);
+
+        /*
+         * @brief Copies another sequence into a memory resource.
+         *
+         * @param other The sequence to copy.
+         * @param resource The memory resource used for the copy.
+         */
+        PackedBlocks(const PackedBlocks& other, std::pmr::memory_resource* resource);
+
+        /*
+         * @brief Replaces the sequence.
+         *
+         * @param keys The keys, strictly ascending.
+         */
+        void assign(std::span<const uint32_t> keys);
+
+        /*
+         * @brief Returns the number of keys.
+         *
+         * @return The number of keys.
+         */
+        size_t size() const;
+
+        /*
+         * @brief Decodes the key at a position.
+         *
+         * @param index The position, smaller than size().
+         * @return The key.
+         */
+        uint32_t at(size_t index) const;
+
+        /*
+         * @brief Finds the first key that is not smaller than a given key.
+         *
+         * @param key The key to look for.
+         * @return The position of that key, or size() if every key is smaller.
+         */
+        size_t lowerBound(uint32_t key) const;
+
+        /*
+         * @brief Measures the memory held by the sequence.
+         *
+         * @return The bytes of the skip index and the packed words.
+         */
+        Footprint footprint() const;
+
+    private:
+        struct Block
+        {
+            uint32_t first;     // The first key of the block
+            uint32_t offset;    // Position of the block's first word in words
+            uint8_t width;      // Bits per packed key offset
+        };
+
+        std::pmr::vector<Block> blocks;     // One entry per block, searchable by first key
+        std::pmr::vector<uint64_t> words;   // The packed key offsets of all blocks
+        size_t keys = 0;                    // The number of keys
+    };
+
+    /*
+     * @brief A read-mostly backend that keeps the ascending order bit-packed and derives the other orders from it.
+     *
+     * The ascending order is stored as PackedBlocks over the elements, the prime order as PackedBlocks over
+     * the positions of the prime elements, and the side-cross order is computed from the ascending positions.
+     * Every traversal position decodes in O(1).
+     *
+     * Single additions and removals are buffered by BufferedStore, and the next read of an order merges the
+     * whole burst into the packed blocks with one re-encode, so k modifications followed by a read cost
+     * O(n + k log k) instead of one re-encode each.
+     */
+    class CompressedStore : public BufferedStore
+    {
+    public:
+        /*
+         * @brief Constructs an empty store allocating from a memory resource.
+         *
+         * @param resource The memory resource used for every structure of the store.
+         */
+        explicit CompressedStore(std::pmr::memory_resource* resource);
+
+        /*
+         * @brief Copies another store into the same memory resource.
+         *
+         * @param other The store to copy.
+         */
+        CompressedStore(const CompressedStore& other);
+
+        CompressedStore(CompressedStore&& other) = delete;
+        CompressedStore& operator=(const CompressedStore& other) = delete;
+        CompressedStore& operator=(CompressedStore&& other) = delete;
+        ~CompressedStore() override = default;
+
+        std::shared_ptr<ElementStore> clone() const override;
+        StorageBackend backend() const override;
+        std::pmr::memory_resource* resource() const override;
+        size_t count(TraversalMode mode) const override;
+        int at(TraversalMode mode, size_t index) const override;
+        void assign(std::span<const int> sorted, std::span<const int> primes) override;
+        MemoryFootprint memoryFootprint() const override;
+
+    protected:
+        bool containsCommitted(int element) const override;
+        size_t merge(const std::vector<int>& added, const std::vector<int>& removed) const override;
+
+    private:
+        std::pmr::memory_resource* memory;                      // The memory resource of the store
+        mutable PackedBlocks values;                            // The elements in ascending order, as keys, once committed
+        mutable PackedBlocks primePositions;                    // Ascending positions of the prime elements, once committed
+    };
+}
+
+#endif
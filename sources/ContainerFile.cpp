@@ -0,0 +1,322 @@
+#include "ContainerFile.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+namespace ariel{
+/*
+ * @brief Appends an unsigned integer in little-endian byte order.
+ */
+static void putFixed(vector<uint8_t> &bytes, uint64_t value, size_t width)
+{
+    for (size_t byte = 0; byte < width; ++byte)
+    {
+        bytes.push_back(static_cast<uint8_t>(value >> (8 * byte)));
+    }
+}
+
+/*
+ * @brief Reads an unsigned integer in little-endian byte order.
+ */
+static uint64_t getFixed(span<const uint8_t> bytes, size_t offset, size_t width)
+{
+    uint64_t value = 0;
+    for (size_t byte = 0; byte < width; ++byte)
+    {
+        value |= uint64_t{bytes[offset + byte]} << (8 * byte);
+    }
+    return value;
+}
+
+/*
+ * @brief Appends a LEB128 varint.
+ */
+static void putVarint(vector<uint8_t> &bytes, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+/*
+ * @brief Encodes an ascending order and its prime subsequence, each read one position at a time.
+ */
+template <typename ElementAt, typename PrimeAt>
+static vector<uint8_t> encodeOrder(size_t count, size_t primeCount, ElementAt elementAt, PrimeAt primeAt,
+                                   ContainerFile::Encoding encoding)
+{
+    using Encoding = ContainerFile::Encoding;
+
+    vector<uint8_t> values, primes;
+    if (encoding == Encoding::Delta)
+    {
+        values.reserve(count * 2);
+        primes.assign((count + 7) / 8, 0);
+    }
+    else
+    {
+        values.reserve(count * 4);
+        primes.reserve(primeCount * 4);
+    }
+
+    // The prime order is a subsequence of the ascending one, so one merge finds the prime positions
+    uint32_t previous = 0;
+    size_t prime = 0;
+    int nextPrime = primeCount > 0 ? primeAt(0) : 0;
+    for (size_t position = 0; position < count; ++position)
+    {
+        int element = elementAt(position);
+        uint32_t key = ElementStore::toKey(element);
+        bool isPrime = prime < primeCount && element == nextPrime;
+
+        if (encoding == Encoding::Delta)
+        {
+            putVarint(values, position == 0 ? key : key - previous);
+            if (isPrime)
+            {
+                primes[position / 8] = static_cast<uint8_t>(primes[position / 8] | 1U << (position % 8));
+            }
+        }
+        else
+        {
+            putFixed(values, static_cast<uint32_t>(element), 4);
+            if (isPrime)
+            {
+                putFixed(primes, position, 4);
+            }
+        }
+
+        previous = key;
+        if (isPrime && ++prime < primeCount)
+        {
+            nextPrime = primeAt(prime);
+        }
+    }
+
+    vector<uint8_t> bytes;
+    bytes.reserve(ContainerFile::HeaderSize + values.size() + primes.size());
+    bytes.insert(bytes.end(), begin(ContainerFile::Magic), end(ContainerFile::Magic));
+    putFixed(bytes, ContainerFile::Version, 2);
+    putFixed(bytes, static_cast<uint16_t>(encoding), 2);
+    putFixed(bytes, primeCount, 8);
+    putFixed(bytes, count, 8);
+    putFixed(bytes, values.size(), 8);
+    bytes.insert(bytes.end(), values.begin(), values.end());
+    bytes.insert(bytes.end(), primes.begin(), primes.end());
+    return bytes;
+}
+
+vector<uint8_t> ContainerFile::encode(const MagicalContainer &container, Encoding encoding)
+{
+    return encodeOrder(
+        container.count(TraversalMode::Ascending), container.count(TraversalMode::Prime),
+        [&container](size_t position) { return container.at(TraversalMode::Ascending, position); },
+        [&container](size_t prime) { return container.at(TraversalMode::Prime, prime); }, encoding);
+}
+
+vector<uint8_t> ContainerFile::encode(span<const int> sorted, span<const int> primes, Encoding encoding)
+{
+    return encodeOrder(
+        sorted.size(), primes.size(), [sorted](size_t position) { return sorted[position]; },
+        [primes](size_t prime) { return primes[prime]; }, encoding);
+}
+
+ContainerFile::Header ContainerFile::parseHeader(span<const uint8_t> bytes)
+{
+    if (bytes.size() < HeaderSize || !equal(begin(Magic), end(Magic), bytes.begin()))
+    {
+        throw runtime_error("Error: not a container file");
+    }
+
+    Header header;
+    header.version = static_cast<uint16_t>(getFixed(bytes, 4, 2));
+    header.encoding = static_cast<Encoding>(getFixed(bytes, 6, 2));
+    header.primeCount = getFixed(bytes, 8, 8);
+    header.count = getFixed(bytes, 16, 8);
+    header.valueBytes = getFixed(bytes, 24, 8);
+
+    if (header.version > Version)
+    {
+        throw runtime_error("Error: unsupported container file version");
+    }
+
+    if (header.encoding != Encoding::Delta && header.encoding != Encoding::Raw)
+    {
+        throw runtime_error("Error: unsupported container file encoding");
+    }
+
+    // Compare sizes without overflowing: every count is first checked against the file size
+    size_t payload = bytes.size() - HeaderSize;
+    bool sized = header.count <= payload && header.primeCount <= header.count && header.valueBytes <= payload;
+    if (sized && header.encoding == Encoding::Delta)
+    {
+        sized = payload - header.valueBytes == (header.count + 7) / 8;
+    }
+    else if (sized)
+    {
+        sized = header.valueBytes == header.count * 4 && payload - header.valueBytes == header.primeCount * 4;
+    }
+
+    if (!sized)
+    {
+        throw runtime_error("Error: truncated container file");
+    }
+
+    return header;
+}
+
+void ContainerFile::decode(span<const uint8_t> bytes, vector<int> &sorted, vector<int> &primes)
+{
+    Header header = parseHeader(bytes);
+    span<const uint8_t> values = bytes.subspan(HeaderSize, header.valueBytes);
+    span<const uint8_t> rest = bytes.subspan(HeaderSize + header.valueBytes);
+
+    sorted.clear();
+    primes.clear();
+    sorted.reserve(header.count);
+    primes.reserve(header.primeCount);
+
+    if (header.encoding == Encoding::Raw)
+    {
+        for (size_t position = 0; position < header.count; ++position)
+        {
+            auto element = static_cast<int>(static_cast<uint32_t>(getFixed(values, position * 4, 4)));
+            if (position > 0 && element <= sorted.back())
+            {
+                throw runtime_error("Error: corrupt container file");
+            }
+            sorted.push_back(element);
+        }
+
+        for (size_t prime = 0; prime < header.primeCount; ++prime)
+        {
+            uint64_t position = getFixed(rest, prime * 4, 4);
+            if (position >= header.count || (prime > 0 && position <= getFixed(rest, (prime - 1) * 4, 4)))
+            {
+                throw runtime_error("Error: corrupt container file");
+            }
+            primes.push_back(sorted[position]);
+        }
+        return;
+    }
+
+    uint64_t key = 0;
+    size_t offset = 0;
+    for (size_t position = 0; position < header.count; ++position)
+    {
+        uint64_t delta = 0;
+        for (unsigned int shift = 0;; shift += 7)
+        {
+            if (offset == values.size() || shift > 28)
+            {
+                throw runtime_error("Error: corrupt container file");
+            }
+
+            uint8_t byte = values[offset++];
+            delta |= uint64_t{byte & 0x7FU} << shift;
+            if ((byte & 0x80U) == 0)
+            {
+                break;
+            }
+        }
+
+        // Every key after the first must grow, and all of them must fit 32 bits
+        if ((position > 0 && delta == 0) || key + delta > UINT32_MAX)
+        {
+            throw runtime_error("Error: corrupt container file");
+        }
+
+        key += delta;
+        int element = ElementStore::fromKey(static_cast<uint32_t>(key));
+        sorted.push_back(element);
+        if ((rest[position / 8] >> (position % 8)) & 1U)
+        {
+            primes.push_back(element);
+        }
+    }
+
+    if (offset != values.size() || primes.size() != header.primeCount)
+    {
+        throw runtime_error("Error: corrupt container file");
+    }
+}
+
+void ContainerFile::save(const MagicalContainer &container, const string &path, Encoding encoding)
+{
+    writeFile(path, encode(container, encoding), true);
+}
+
+void ContainerFile::load(MagicalContainer &container, const string &path)
+{
+    vector<int> sorted, primes;
+    decode(readFile(path), sorted, primes);
+    container.replace(sorted, primes);
+}
+
+vector<uint8_t> ContainerFile::readFile(const string &path)
+{
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file)
+    {
+        throw runtime_error("Error: cannot open " + path);
+    }
+
+    auto size = static_cast<size_t>(file.tellg());
+    vector<uint8_t> bytes(size);
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char *>(bytes.data()), static_cast<streamsize>(size)))
+    {
+        throw runtime_error("Error: cannot read " + path);
+    }
+
+    return bytes;
+}
+
+void ContainerFile::writeFile(const string &path, span<const uint8_t> bytes, bool sync)
+{
+    // The bytes go to a temporary file renamed over the target, so a failed or interrupted write never
+    // destroys the previous version
+    string temporary = path + ".tmp";
+    int descriptor = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (descriptor < 0)
+    {
+        throw runtime_error("Error: cannot write " + path);
+    }
+
+    bool written = writeAll(descriptor, bytes) && (!sync || fsync(descriptor) == 0);
+    if (close(descriptor) != 0 || !written || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        unlink(temporary.c_str());
+        throw runtime_error("Error: cannot write " + path);
+    }
+}
+
+bool ContainerFile::writeAll(int descriptor, span<const uint8_t> bytes)
+{
+    while (!bytes.empty())
+    {
+        ssize_t written = write(descriptor, bytes.data(), bytes.size());
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+        bytes = bytes.subspan(static_cast<size_t>(written));
+    }
+
+    return true;
+}
+}
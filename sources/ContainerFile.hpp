@@ -0,0 +1,144 @@
+#ifndef CONTAINER_FILE_HPP
+#define CONTAINER_FILE_HPP
+
+#include "MagicalContainer.hpp"
+
+#include <string>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+namespace ariel
+{
+    /*
+     * @brief The binary file format of a saved container.
+     *
+     * A file is a 32-byte little-endian header followed by the payload:
+     *   magic "MGCF" | version (u16) | encoding (u16) | prime count (u64) | element count (u64) | value bytes (u64)
+     * With the Delta encoding the values are the ascending element keys (ElementStore::toKey) as LEB128 varints,
+     * the first one whole and every other one as the difference to its predecessor. A prime bitmap with one bit
+     * per ascending position follows, so loading neither sorts nor tests primality.
+     * With the Raw encoding the values are the ascending elements as 32-bit integers, followed by the 32-bit
+     * ascending positions of the prime elements. Both arrays are 4-byte aligned, so a mapped Raw file can be
+     * traversed in place (MappedMagicalContainer).
+     */
+    class ContainerFile
+    {
+    public:
+        static constexpr char Magic[4] = {'M', 'G', 'C', 'F'};    // The first bytes of every file
+        static constexpr uint16_t Version = 1;                     // The newest version this code reads and writes
+        static constexpr size_t HeaderSize = 32;                   // Bytes before the payload
+
+        /*
+         * @brief The ways the values of a file can be laid out.
+         */
+        enum class Encoding : uint16_t
+        {
+            Delta = 0,      // Varint deltas between ascending keys, then a prime bitmap
+            Raw = 1         // Fixed-width elements, then fixed-width prime positions
+        };
+
+        /*
+         * @brief The fields of a file header.
+         */
+        struct Header
+        {
+            uint16_t version;       // The format version the file was written with
+            Encoding encoding;      // The layout of the values
+            uint64_t primeCount;    // The number of prime elements
+            uint64_t count;         // The number of elements
+            uint64_t valueBytes;    // Bytes of the encoded elements, before the prime section
+        };
+
+        /*
+         * @brief Reads and checks the header of a file against the file size.
+         *
+         * @param bytes The bytes of the file.
+         * @return The header.
+         * @throws std::runtime_error If the bytes do not start with a supported header of a complete file.
+         */
+        static Header parseHeader(std::span<const uint8_t> bytes);
+
+        /*
+         * @brief Encodes the contents of a container.
+         *
+         * @param container The container.
+         * @param encoding The layout of the values.
+         * @return The bytes of the file.
+         */
+        static std::vector<uint8_t> encode(const MagicalContainer& container, Encoding encoding = Encoding::Delta);
+
+        /*
+         * @brief Encodes an ascending order of unique elements and its prime elements.
+         *
+         * @param sorted The elements, strictly ascending.
+         * @param primes The prime elements among them, strictly ascending.
+         * @param encoding The layout of the values.
+         * @return The bytes of the file.
+         */
+        static std::vector<uint8_t> encode(std::span<const int> sorted, std::span<const int> primes,
+                                           Encoding encoding = Encoding::Delta);
+
+        /*
+         * @brief Decodes and validates the bytes of a file of either encoding.
+         *
+         * @param bytes The bytes of the file.
+         * @param sorted Receives the elements, in ascending order.
+         * @param primes Receives the prime elements, in ascending order.
+         * @throws std::runtime_error If the bytes are not a valid file of a supported version.
+         */
+        static void decode(std::span<const uint8_t> bytes, std::vector<int>& sorted, std::vector<int>& primes);
+
+        /*
+         * @brief Writes the contents of a container to a file, replacing it.
+         *
+         * @param container The container.
+         * @param path The file.
+         * @param encoding The layout of the values.
+         * @throws std::runtime_error If the file cannot be written.
+         */
+        static void save(const MagicalContainer& container, const std::string& path, Encoding encoding = Encoding::Delta);
+
+        /*
+         * @brief Replaces the contents of a container with a file, read in one go.
+         *
+         * @param container The container, which keeps its backend and memory resource.
+         * @param path The file.
+         * @throws std::runtime_error If the file cannot be read or is not valid.
+         */
+        static void load(MagicalContainer& container, const std::string& path);
+
+        /*
+         * @brief Reads a whole file.
+         *
+         * @param path The file.
+         * @return Its bytes.
+         * @throws std::runtime_error If the file cannot be read.
+         */
+        static std::vector<uint8_t> readFile(const std::string& path);
+
+        /*
+         * @brief Writes a whole file, replacing it atomically.
+         *
+         * The bytes are written to path + ".tmp", which is then renamed over the file, so readers and crashes
+         * see either the old or the new version. The directory entry itself is not synced.
+         *
+         * @param path The file.
+         * @param bytes The bytes to write.
+         * @param sync True to flush the new version to the disk before it replaces the old one.
+         * @throws std::runtime_error If the file cannot be written. The old version, if any, is left in place.
+         */
+        static void writeFile(const std::string& path, std::span<const uint8_t> bytes, bool sync = false);
+
+        /*
+         * @brief Writes all the bytes to a file descriptor, retrying short and interrupted writes.
+         *
+         * @param descriptor The file descriptor.
+         * @param bytes The bytes to write.
+         * @return False if a write failed.
+         */
+        static bool writeAll(int descriptor, std::span<const uint8_t> bytes);
+    };
+}
+
+#endif
@@ -0,0 +1,152 @@
+#include "ElementStore.hpp"
+#include "IndexedStore.hpp"
+#include "CompressedStore.hpp"
+#include "BitmapStore.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <cmath>
+
+using namespace std;
+
+
+namespace ariel{
+shared_ptr<ElementStore> ElementStore::create(StorageBackend backend, pmr::memory_resource *resource)
+{
+    switch (backend)
+    {
+    case StorageBackend::Indexed:
+        return allocate_shared<IndexedStore>(pmr::polymorphic_allocator<IndexedStore>(resource), resource);
+    case StorageBackend::Compressed:
+        return allocate_shared<CompressedStore>(pmr::polymorphic_allocator<CompressedStore>(resource), resource);
+    case StorageBackend::Bitmap:
+        return allocate_shared<BitmapStore>(pmr::polymorphic_allocator<BitmapStore>(resource), resource);
+    case StorageBackend::Mapped:
+        throw invalid_argument("Error: mapped stores are opened from a file");
+    }
+
+    throw invalid_argument("Unknown storage backend");
+}
+
+bool ElementStore::isPrime(int num)
+{
+    // Widened first, since the smallest int has no positive counterpart
+    long long value = num;
+    if (value < 0)
+        value = -value;
+
+    if (value <= 1)
+    {
+        return false;
+    }
+
+    for (long long i = 2; i <= sqrt(value); ++i)
+    {
+        if (value % i == 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ElementStore::insert(int element)
+{
+    applyBatch({element}, {});
+}
+
+void ElementStore::erase(int element)
+{
+    applyBatch({}, {element});
+}
+
+void ElementStore::applyBatch(const vector<int> &additions, const vector<int> &removals)
+{
+    vector<int> removed(removals);
+    sort(removed.begin(), removed.end());
+    removed.erase(unique(removed.begin(), removed.end()), removed.end());
+
+    vector<int> added(additions);
+    sort(added.begin(), added.end());
+    added.erase(unique(added.begin(), added.end()), added.end());
+
+    vector<int> addedPrimes;
+    copy_if(added.begin(), added.end(), back_inserter(addedPrimes), isPrime);
+
+    vector<int> kept, sorted;
+    vector<int> current = elements(TraversalMode::Ascending);
+    set_difference(current.begin(), current.end(), removed.begin(), removed.end(), back_inserter(kept));
+    set_union(kept.begin(), kept.end(), added.begin(), added.end(), back_inserter(sorted));
+
+    vector<int> keptPrimes, primes;
+    current = elements(TraversalMode::Prime);
+    set_difference(current.begin(), current.end(), removed.begin(), removed.end(), back_inserter(keptPrimes));
+    set_union(keptPrimes.begin(), keptPrimes.end(), addedPrimes.begin(), addedPrimes.end(), back_inserter(primes));
+
+    assign(sorted, primes);
+}
+
+void ElementStore::reserve(size_t)
+{
+}
+
+void ElementStore::shrinkToFit()
+{
+}
+
+size_t ElementStore::capacity() const
+{
+    return size();
+}
+
+size_t ElementStore::rank(TraversalMode mode, int element) const
+{
+    if (mode == TraversalMode::SideCross)
+    {
+        throw invalid_argument("Error: the side-cross order is not sorted");
+    }
+
+    size_t low = 0, high = count(mode);
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (at(mode, middle) < element)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+void ElementStore::prepare(TraversalMode) const
+{
+}
+
+void ElementStore::dropIndexes()
+{
+}
+
+void ElementStore::commit() const
+{
+}
+
+vector<int> ElementStore::elements(TraversalMode mode) const
+{
+    vector<int> result;
+    result.reserve(count(mode));
+
+    for (size_t index = 0; index < count(mode); ++index)
+    {
+        result.push_back(at(mode, index));
+    }
+
+    return result;
+}
+}
@@ -0,0 +1,331 @@
+#ifndef ELEMENT_STORE_HPP
+#define ELEMENT_STORE_HPP
+
+#include <vector>
+#include <span>
+#include <memory>
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
+
+namespace ariel
+{
+    /*
+     * @brief The traversal orders offered by the container, one per iterator type.
+     */
+    enum class TraversalMode
+    {
+        Ascending,      // Elements in ascending order (AscendingIterator)
+        SideCross,      // One from the start, then one from the end (SideCrossIterator)
+        Prime           // Prime elements only, in ascending order (PrimeIterator)
+    };
+
+    /*
+     * @brief The ways a container can lay out its elements in memory.
+     */
+    enum class StorageBackend
+    {
+        Indexed,        // Element set plus one index vector per traversal mode (IndexedStore)
+        Compressed,     // Bit-packed blocks of sorted values, read-mostly (CompressedStore)
+        Bitmap,         // Roaring-style array, bitmap and run chunks, for dense ranges (BitmapStore)
+        Mapped          // Read-only view of a mapped container file (MappedStore), see MappedMagicalContainer
+    };
+
+    /*
+     * @brief The ways a traversal order can be exported (TraversalExport).
+     */
+    enum class ExportFormat
+    {
+        Text,           // One decimal element per line
+        Binary          // Consecutive little-endian 32-bit elements
+    };
+
+    /*
+     * @brief Bytes held by one internal structure.
+     */
+    struct Footprint
+    {
+        size_t used = 0;        // Bytes holding live data
+        size_t reserved = 0;    // Bytes allocated, including unused capacity
+
+        /*
+         * @brief Adds the bytes of another structure.
+         *
+         * @param other The other structure's footprint.
+         * @return A reference to this footprint.
+         */
+        Footprint& operator+=(const Footprint& other)
+        {
+            used += other.used;
+            reserved += other.reserved;
+            return *this;
+        }
+
+        /*
+         * @brief Measures the buffer of a vector.
+         *
+         * @param vector The vector.
+         * @return Its size and capacity, in bytes.
+         */
+        template <typename T, typename Allocator>
+        static Footprint of(const std::vector<T, Allocator>& vector)
+        {
+            return {vector.size() * sizeof(T), vector.capacity() * sizeof(T)};
+        }
+    };
+
+    /*
+     * @brief The memory of a container's current version, broken down by the role of each structure.
+     *
+     * Backends that derive an order instead of storing it report zero bytes for it.
+     */
+    struct MemoryFootprint
+    {
+        Footprint values;       // The elements themselves
+        Footprint ascending;    // The ascending order index
+        Footprint sideCross;    // The side-cross order index
+        Footprint prime;        // The prime order index
+        Footprint overhead;     // The store object and any lookup tables or caches
+
+        /*
+         * @brief Sums every structure.
+         *
+         * @return The total footprint.
+         */
+        Footprint total() const
+        {
+            Footprint sum = values;
+            sum += ascending;
+            sum += sideCross;
+            sum += prime;
+            sum += overhead;
+            return sum;
+        }
+    };
+
+    /*
+     * @brief One version of a container's contents, in the layout of one storage backend.
+     *
+     * MagicalContainer shares a store between its copies and snapshots, and clones it before the first
+     * write to a shared store. Every store allocates from the memory resource it was created with.
+     */
+    class ElementStore
+    {
+    public:
+        ElementStore() = default;
+        ElementStore(const ElementStore& other) = default;
+        ElementStore(ElementStore&& other) = delete;
+        ElementStore& operator=(const ElementStore& other) = delete;
+        ElementStore& operator=(ElementStore&& other) = delete;
+        virtual ~ElementStore() = default;
+
+        /*
+         * @brief Creates an empty store of the given backend.
+         *
+         * @param backend The layout of the store.
+         * @param resource The memory resource the store allocates from.
+         * @return The new store, itself allocated from the resource.
+         */
+        static std::shared_ptr<ElementStore> create(StorageBackend backend, std::pmr::memory_resource* resource);
+
+        /*
+         * @brief Checks if a number is prime.
+         *
+         * @param num The number to check.
+         * @return True if the number is prime, false otherwise.
+         */
+        static bool isPrime(int num);
+
+        /*
+         * @brief Maps a position of the side-cross order to the matching position of the ascending order.
+         *
+         * @param index The position in the side-cross order.
+         * @param size The number of elements.
+         * @return The position in the ascending order.
+         */
+        static size_t crossToAscending(size_t index, size_t size)
+        {
+            return index % 2 == 0 ? index / 2 : size - 1 - index / 2;
+        }
+
+        /*
+         * @brief Maps an element to a key whose unsigned order matches the signed order of the elements.
+         *
+         * @param element The element.
+         * @return The key.
+         */
+        static uint32_t toKey(int element)
+        {
+            return static_cast<uint32_t>(element) ^ 0x80000000U;
+        }
+
+        /*
+         * @brief Maps a key back to its element.
+         *
+         * @param key The key.
+         * @return The element.
+         */
+        static int fromKey(uint32_t key)
+        {
+            return static_cast<int>(key ^ 0x80000000U);
+        }
+
+        /*
+         * @brief Copies the store into a new, unshared store with the same backend and memory resource.
+         *
+         * @return The copy.
+         */
+        virtual std::shared_ptr<ElementStore> clone() const = 0;
+
+        /*
+         * @brief Returns the backend of the store.
+         *
+         * @return The backend.
+         */
+        virtual StorageBackend backend() const = 0;
+
+        /*
+         * @brief Returns the memory resource the store allocates from.
+         *
+         * @return The memory resource.
+         */
+        virtual std::pmr::memory_resource* resource() const = 0;
+
+        /*
+         * @brief Returns the number of elements.
+         *
+         * @return The number of elements.
+         */
+        virtual size_t size() const = 0;
+
+        /*
+         * @brief Returns the number of positions of a traversal order.
+         *
+         * @param mode The traversal mode.
+         * @return The number of positions.
+         */
+        virtual size_t count(TraversalMode mode) const = 0;
+
+        /*
+         * @brief Returns the element at a position of a traversal order.
+         *
+         * @param mode The traversal mode.
+         * @param index The position.
+         * @return The element.
+         * @throws std::out_of_range If the index is past the end of the traversal.
+         */
+        virtual int at(TraversalMode mode, size_t index) const = 0;
+
+        /*
+         * @brief Checks if an element is stored.
+         *
+         * @param element The element to look for.
+         * @return True if the element is stored.
+         */
+        virtual bool contains(int element) const = 0;
+
+        /*
+         * @brief Adds an element that is not stored yet.
+         *
+         * @param element The element to add.
+         */
+        virtual void insert(int element);
+
+        /*
+         * @brief Removes an element that is stored.
+         *
+         * @param element The element to remove.
+         */
+        virtual void erase(int element);
+
+        /*
+         * @brief Applies removals, then additions, ignoring elements already present or absent.
+         *
+         * The default implementation extracts the contents, merges the sorted batch in and reassigns them.
+         *
+         * @param additions The elements to add.
+         * @param removals The elements to remove.
+         */
+        virtual void applyBatch(const std::vector<int>& additions, const std::vector<int>& removals);
+
+        /*
+         * @brief Replaces the contents with already sorted elements whose prime subset is known.
+         *
+         * @param sorted The elements, strictly ascending.
+         * @param primes The prime elements of sorted, strictly ascending.
+         */
+        virtual void assign(std::span<const int> sorted, std::span<const int> primes) = 0;
+
+        /*
+         * @brief Pre-sizes the internal structures for a number of elements. Does nothing by default.
+         *
+         * @param elements The number of elements to make room for.
+         */
+        virtual void reserve(size_t elements);
+
+        /*
+         * @brief Releases memory held beyond the current elements. Does nothing by default.
+         */
+        virtual void shrinkToFit();
+
+        /*
+         * @brief Returns the number of elements the store can hold without reallocating.
+         *
+         * The default is size(), for backends that re-encode on every modification anyway.
+         *
+         * @return The capacity.
+         */
+        virtual size_t capacity() const;
+
+        /*
+         * @brief Returns the number of elements of a sorted traversal order that are less than a value.
+         *
+         * The default is a binary search over at().
+         *
+         * @param mode The ascending or prime order.
+         * @param element The value.
+         * @return The first position of that order holding an element not less than the value.
+         * @throws std::invalid_argument For the side-cross order, which is not sorted.
+         */
+        virtual size_t rank(TraversalMode mode, int element) const;
+
+        /*
+         * @brief Measures the memory held by the store.
+         *
+         * @return The bytes used and reserved by each structure.
+         */
+        virtual MemoryFootprint memoryFootprint() const = 0;
+
+        /*
+         * @brief Builds the index behind a traversal order ahead of its first use. Does nothing by default.
+         *
+         * Safe to call from several readers of the same store at once.
+         *
+         * @param mode The traversal mode.
+         */
+        virtual void prepare(TraversalMode mode) const;
+
+        /*
+         * @brief Releases the indexes that can be rebuilt on demand. Does nothing by default.
+         */
+        virtual void dropIndexes();
+
+        /*
+         * @brief Applies modifications that were only recorded so far. Does nothing by default.
+         *
+         * Reads commit on their own; calling it explicitly moves the cost out of the first read.
+         * Safe to call from several readers of the same store at once.
+         */
+        virtual void commit() const;
+
+        /*
+         * @brief Copies the elements of a traversal order into a vector.
+         *
+         * @param mode The traversal mode.
+         * @return The elements in that order.
+         */
+        std::vector<int> elements(TraversalMode mode) const;
+    };
+}
+
+#endif
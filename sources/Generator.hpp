@@ -0,0 +1,172 @@
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <cstddef>
+
+namespace ariel
+{
+    /*
+     * @brief A lazily evaluated sequence produced by a coroutine that co_yields values of type T.
+     *
+     * The coroutine runs only while the sequence is advanced, and stays suspended between two values.
+     * A Generator is a single-pass input range and can be consumed with a range-based for loop.
+     */
+    template <typename T>
+    class Generator
+    {
+    public:
+        struct promise_type
+        {
+            const T* current = nullptr;     // The value passed to the latest co_yield
+            std::exception_ptr error;       // The exception that escaped the coroutine, if any
+
+            Generator get_return_object()
+            {
+                return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            std::suspend_always final_suspend() noexcept
+            {
+                return {};
+            }
+
+            std::suspend_always yield_value(const T& value) noexcept
+            {
+                current = std::addressof(value);
+                return {};
+            }
+
+            void return_void() noexcept {}
+
+            void unhandled_exception()
+            {
+                error = std::current_exception();
+            }
+        };
+
+        /*
+         * @brief Input iterator that resumes the coroutine on every increment.
+         */
+        class Iterator
+        {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+
+            Iterator() = default;
+
+            explicit Iterator(std::coroutine_handle<promise_type> coroutine)
+                : coroutine(coroutine) {}
+
+            const T& operator*() const
+            {
+                return *coroutine.promise().current;
+            }
+
+            Iterator& operator++()
+            {
+                resume(coroutine);
+                return *this;
+            }
+
+            void operator++(int)
+            {
+                ++*this;
+            }
+
+            bool operator==(std::default_sentinel_t) const
+            {
+                return !coroutine || coroutine.done();
+            }
+
+        private:
+            std::coroutine_handle<promise_type> coroutine;  // The coroutine producing the values
+        };
+
+        explicit Generator(std::coroutine_handle<promise_type> coroutine)
+            : coroutine(coroutine) {}
+
+        Generator(const Generator& other) = delete;
+        Generator& operator=(const Generator& other) = delete;
+
+        Generator(Generator&& other) noexcept
+            : coroutine(std::exchange(other.coroutine, {})) {}
+
+        Generator& operator=(Generator&& other) noexcept
+        {
+            if (this != &other)
+            {
+                if (coroutine)
+                {
+                    coroutine.destroy();
+                }
+                coroutine = std::exchange(other.coroutine, {});
+            }
+
+            return *this;
+        }
+
+        ~Generator()
+        {
+            if (coroutine)
+            {
+                coroutine.destroy();
+            }
+        }
+
+        /*
+         * @brief Runs the coroutine up to its first value.
+         *
+         * @return An iterator positioned at the first value.
+         */
+        Iterator begin()
+        {
+            resume(coroutine);
+            return Iterator(coroutine);
+        }
+
+        /*
+         * @brief Returns the sentinel reached once the coroutine finishes.
+         *
+         * @return The end sentinel.
+         */
+        std::default_sentinel_t end() const noexcept
+        {
+            return std::default_sentinel;
+        }
+
+    private:
+        std::coroutine_handle<promise_type> coroutine;  // The coroutine producing the values
+
+        /*
+         * @brief Resumes a coroutine and rethrows the exception that escaped it, if any.
+         *
+         * @param coroutine The coroutine to resume.
+         */
+        static void resume(std::coroutine_handle<promise_type> coroutine)
+        {
+            if (coroutine && !coroutine.done())
+            {
+                coroutine.resume();
+
+                if (coroutine.promise().error)
+                {
+                    std::rethrow_exception(std::exchange(coroutine.promise().error, nullptr));
+                }
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,83 @@
+#include "HugePageResource.hpp"
+
+#include <new>
+#include <cstdint>
+#include <sys/mman.h>
+
+using namespace std;
+
+
+namespace ariel{
+HugePageResource::HugePageResource(size_t threshold, pmr::memory_resource *upstream)
+    : threshold(threshold), upstream(upstream) {}
+
+size_t HugePageResource::mappedBytes() const
+{
+    return mapped.load(memory_order_relaxed);
+}
+
+size_t HugePageResource::mappings() const
+{
+    return live.load(memory_order_relaxed);
+}
+
+size_t HugePageResource::mappingSize(size_t bytes)
+{
+    return (bytes + HugePageSize - 1) / HugePageSize * HugePageSize;
+}
+
+void *HugePageResource::do_allocate(size_t bytes, size_t alignment)
+{
+    if (bytes < threshold || alignment > HugePageSize)
+    {
+        return upstream->allocate(bytes, alignment);
+    }
+
+    // Over-map by one huge page, then trim both ends so the mapping starts on a huge page boundary
+    size_t size = mappingSize(bytes);
+    void *raw = mmap(nullptr, size + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+    {
+        throw bad_alloc();
+    }
+
+    auto start = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (start + HugePageSize - 1) / HugePageSize * HugePageSize;
+    if (aligned > start)
+    {
+        munmap(raw, aligned - start);
+    }
+    if (aligned + size < start + size + HugePageSize)
+    {
+        munmap(reinterpret_cast<void *>(aligned + size), start + size + HugePageSize - aligned - size);
+    }
+
+    void *pointer = reinterpret_cast<void *>(aligned);
+#ifdef MADV_HUGEPAGE
+    madvise(pointer, size, MADV_HUGEPAGE);
+#endif
+
+    mapped.fetch_add(size, memory_order_relaxed);
+    live.fetch_add(1, memory_order_relaxed);
+    return pointer;
+}
+
+void HugePageResource::do_deallocate(void *pointer, size_t bytes, size_t alignment)
+{
+    if (bytes < threshold || alignment > HugePageSize)
+    {
+        upstream->deallocate(pointer, bytes, alignment);
+        return;
+    }
+
+    size_t size = mappingSize(bytes);
+    munmap(pointer, size);
+    mapped.fetch_sub(size, memory_order_relaxed);
+    live.fetch_sub(1, memory_order_relaxed);
+}
+
+bool HugePageResource::do_is_equal(const pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
+}
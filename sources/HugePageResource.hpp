@@ -0,0 +1,75 @@
+#ifndef HUGE_PAGE_RESOURCE_HPP
+#define HUGE_PAGE_RESOURCE_HPP
+
+#include <memory_resource>
+#include <atomic>
+#include <cstddef>
+
+namespace ariel
+{
+    /*
+     * @brief An opt-in memory resource that maps large arrays straight from the kernel, advised for huge pages.
+     *
+     * Allocations of at least a threshold get their own anonymous mapping, aligned to and rounded up to
+     * HugePageSize and advised with MADV_HUGEPAGE, so a traversal over the value and index arrays touches one
+     * TLB entry per 2 MiB instead of per 4 KiB. Smaller allocations go to an upstream resource. Pass it to
+     * MagicalContainer for containers with millions of elements, and reserve() them before loading: the
+     * containers grow through std::pmr vectors, which allocate, copy and free, so growth cannot be turned into
+     * an in-place mremap.
+     *
+     * The resource is thread-safe if its upstream is, and must outlive every container using it.
+     */
+    class HugePageResource : public std::pmr::memory_resource
+    {
+    public:
+        static constexpr size_t HugePageSize = size_t{2} << 20;     // Size of a transparent huge page on x86-64
+
+        /*
+         * @brief Constructs the resource.
+         *
+         * @param threshold The smallest allocation, in bytes, that gets its own mapping.
+         * @param upstream The resource serving smaller allocations.
+         */
+        explicit HugePageResource(size_t threshold = HugePageSize, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+        HugePageResource(const HugePageResource& other) = delete;
+        HugePageResource(HugePageResource&& other) = delete;
+        HugePageResource& operator=(const HugePageResource& other) = delete;
+        HugePageResource& operator=(HugePageResource&& other) = delete;
+        ~HugePageResource() override = default;
+
+        /*
+         * @brief Returns the bytes currently mapped for large allocations.
+         *
+         * @return The mapped bytes, rounded up to whole huge pages.
+         */
+        size_t mappedBytes() const;
+
+        /*
+         * @brief Returns the number of live mappings.
+         *
+         * @return The number of mappings.
+         */
+        size_t mappings() const;
+
+    private:
+        size_t threshold;                       // Smallest allocation that is mapped
+        std::pmr::memory_resource* upstream;    // Resource for smaller allocations
+        std::atomic<size_t> mapped{0};          // Bytes currently mapped
+        std::atomic<size_t> live{0};            // Mappings currently live
+
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+        /*
+         * @brief Returns the mapping size used for an allocation.
+         *
+         * @param bytes The allocation size.
+         * @return The size rounded up to whole huge pages.
+         */
+        static size_t mappingSize(size_t bytes);
+    };
+}
+
+#endif
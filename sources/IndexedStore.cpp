@@ -0,0 +1,340 @@
+#include "IndexedStore.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <mutex>
+#include <iterator>
+
+using namespace std;
+
+
+namespace ariel{
+IndexedStore::IndexedStore(pmr::memory_resource *resource)
+    : BufferedStore(resource), elements(resource), elementsSide(resource), elementsP(resource) {}
+
+IndexedStore::IndexedStore(const IndexedStore &other)
+    : BufferedStore(other), elements(other.elements, other.resource()), elementsSide(other.resource()),
+      elementsP(other.resource())
+{
+
+    // Only indexes the source has built are worth copying; the others stay lazy
+    if (other.sideReady.load(memory_order_acquire))
+    {
+        elementsSide = other.elementsSide;
+        sideReady.store(true, memory_order_relaxed);
+    }
+
+    if (other.primeReady.load(memory_order_acquire))
+    {
+        elementsP = other.elementsP;
+        primeReady.store(true, memory_order_relaxed);
+    }
+}
+
+shared_ptr<ElementStore> IndexedStore::clone() const
+{
+    return allocate_shared<IndexedStore>(pmr::polymorphic_allocator<IndexedStore>(resource()), *this);
+}
+
+StorageBackend IndexedStore::backend() const
+{
+    return StorageBackend::Indexed;
+}
+
+pmr::memory_resource *IndexedStore::resource() const
+{
+    return elements.get_allocator().resource();
+}
+
+size_t IndexedStore::count(TraversalMode mode) const
+{
+    if (mode == TraversalMode::Prime)
+    {
+        prepare(mode);
+        return elementsP.size();
+    }
+
+    return elementCount;
+}
+
+int IndexedStore::at(TraversalMode mode, size_t index) const
+{
+    if (index >= count(mode))
+    {
+        throw out_of_range("Iterator out of range");
+    }
+
+    prepare(mode);
+    switch (mode)
+    {
+    case TraversalMode::Ascending:
+        return elements[index];
+    case TraversalMode::SideCross:
+        return elements[elementsSide[index]];
+    case TraversalMode::Prime:
+        return elements[elementsP[index]];
+    }
+
+    throw invalid_argument("Unknown traversal mode");
+}
+
+bool IndexedStore::containsCommitted(int element) const
+{
+    return binary_search(elements.begin(), elements.end(), element);
+}
+
+size_t IndexedStore::merge(const vector<int> &added, const vector<int> &removed) const
+{
+    if (elements.size() + added.size() > numeric_limits<uint32_t>::max())
+    {
+        throw length_error("Too many elements for 32-bit positions");
+    }
+
+    bool keepPrimes = primeReady.load(memory_order_relaxed);
+
+    // Removals compact the vectors in place, keeping the prime positions in step
+    size_t kept = 0, keptPrimes = 0, prime = 0;
+    auto it_added = added.begin(), it_removed = removed.begin();
+    for (size_t position = 0; position < elements.size(); ++position)
+    {
+        int element = elements[position];
+        bool isPrimeElement = prime < elementsP.size() && elementsP[prime] == position;
+        prime += isPrimeElement ? 1U : 0U;
+
+        // Both lists are ascending, so each pointer only moves forward and the whole pass stays linear
+        while (it_removed != removed.end() && *it_removed < element)
+        {
+            ++it_removed;
+        }
+        while (it_added != added.end() && *it_added < element)
+        {
+            ++it_added;
+        }
+        bool readded = it_added != added.end() && *it_added == element;
+        if (!readded && it_removed != removed.end() && *it_removed == element)
+        {
+            continue;
+        }
+
+        elements[kept] = element;
+        if (isPrimeElement)
+        {
+            elementsP[keptPrimes++] = static_cast<uint32_t>(kept);
+        }
+        ++kept;
+    }
+    elements.resize(kept);
+    elementsP.resize(keptPrimes);
+
+    // Additions merge in from the back, so both vectors grow in place within their capacity
+    vector<int> fresh;
+    set_difference(added.begin(), added.end(), elements.begin(), elements.end(), back_inserter(fresh));
+
+    vector<bool> freshPrime(fresh.size());
+    size_t newPrimes = 0;
+    for (size_t index = 0; keepPrimes && index < fresh.size(); ++index)
+    {
+        freshPrime[index] = isPrime(fresh[index]);
+        newPrimes += freshPrime[index] ? 1U : 0U;
+    }
+
+    size_t oldCount = kept, freshCount = fresh.size(), oldPrimes = keptPrimes;
+    elements.resize(oldCount + freshCount);
+    elementsP.resize(keptPrimes + newPrimes);
+
+    size_t target = elements.size(), primeTarget = elementsP.size();
+    while (freshCount > 0)
+    {
+        --target;
+        if (oldCount > 0 && elements[oldCount - 1] > fresh[freshCount - 1])
+        {
+            --oldCount;
+            elements[target] = elements[oldCount];
+            if (oldPrimes > 0 && elementsP[oldPrimes - 1] == oldCount)
+            {
+                --oldPrimes;
+                elementsP[--primeTarget] = static_cast<uint32_t>(target);
+            }
+        }
+        else
+        {
+            --freshCount;
+            elements[target] = fresh[freshCount];
+            if (freshPrime[freshCount])
+            {
+                elementsP[--primeTarget] = static_cast<uint32_t>(target);
+            }
+        }
+    }
+
+    if (sideReady.load(memory_order_relaxed))
+    {
+        rebuildSideCross();
+    }
+
+    return elements.size();
+}
+
+void IndexedStore::assign(span<const int> sorted, span<const int> primes)
+{
+    discardPending(sorted.size());
+    elements.assign(sorted.begin(), sorted.end());
+    elementsSide.clear();
+    sideReady.store(false, memory_order_relaxed);
+
+    elementsP.clear();
+    elementsP.reserve(primes.size());
+    auto it_prime = primes.begin();
+    for (size_t position = 0; position < elements.size() && it_prime != primes.end(); ++position)
+    {
+        if (elements[position] == *it_prime)
+        {
+            elementsP.push_back(static_cast<uint32_t>(position));
+            ++it_prime;
+        }
+    }
+
+    // The primes come for free here, so that index is built right away
+    primeReady.store(true, memory_order_relaxed);
+}
+
+void IndexedStore::reserve(size_t expected)
+{
+    // Unbuilt indexes stay unallocated; any of the elements may be prime, so a built prime order is sized for all
+    elements.reserve(expected);
+    if (sideReady.load(memory_order_relaxed))
+    {
+        elementsSide.reserve(expected);
+    }
+    if (primeReady.load(memory_order_relaxed))
+    {
+        elementsP.reserve(expected);
+    }
+}
+
+void IndexedStore::shrinkToFit()
+{
+    commit();
+    elements.shrink_to_fit();
+    elementsSide.shrink_to_fit();
+    elementsP.shrink_to_fit();
+}
+
+size_t IndexedStore::capacity() const
+{
+    commit();
+    return elements.capacity();
+}
+
+size_t IndexedStore::rank(TraversalMode mode, int element) const
+{
+    if (mode == TraversalMode::SideCross)
+    {
+        return ElementStore::rank(mode, element);
+    }
+
+    // Both orders are searched in place, the prime one through its positions into the value vector
+    prepare(mode);
+    if (mode == TraversalMode::Ascending)
+    {
+        return static_cast<size_t>(lower_bound(elements.begin(), elements.end(), element) - elements.begin());
+    }
+
+    auto it_prime = partition_point(elementsP.begin(), elementsP.end(),
+                                    [this, element](uint32_t position) { return elements[position] < element; });
+    return static_cast<size_t>(it_prime - elementsP.begin());
+}
+
+void IndexedStore::dropIndexes()
+{
+    elementsSide.clear();
+    elementsSide.shrink_to_fit();
+    elementsP.clear();
+    elementsP.shrink_to_fit();
+    sideReady.store(false, memory_order_relaxed);
+    primeReady.store(false, memory_order_relaxed);
+}
+
+void IndexedStore::prepare(TraversalMode mode) const
+{
+    commit();
+    atomic<bool> &ready = mode == TraversalMode::Prime ? primeReady : sideReady;
+
+    if (mode == TraversalMode::Ascending || ready.load(memory_order_acquire))
+    {
+        return;
+    }
+
+    // Readers sharing a snapshot may race to build the same index; the first one builds it
+    lock_guard<mutex> lock(readMutex);
+    if (ready.load(memory_order_relaxed))
+    {
+        return;
+    }
+
+    if (mode == TraversalMode::SideCross)
+    {
+        rebuildSideCross();
+    }
+    else
+    {
+        elementsP.clear();
+        for (size_t position = 0; position < elements.size(); ++position)
+        {
+            if (isPrime(elements[position]))
+            {
+                elementsP.push_back(static_cast<uint32_t>(position));
+            }
+        }
+    }
+
+    ready.store(true, memory_order_release);
+}
+
+MemoryFootprint IndexedStore::memoryFootprint() const
+{
+    // The value vector is the ascending order, so that order needs no index of its own. A burst not merged
+    // yet is measured as it is, in the buffer, rather than merged by this call
+    lock_guard<mutex> lock(readMutex);
+    MemoryFootprint footprint;
+    footprint.values = Footprint::of(elements);
+    footprint.sideCross = Footprint::of(elementsSide);
+    footprint.prime = Footprint::of(elementsP);
+    footprint.overhead = {sizeof(IndexedStore), sizeof(IndexedStore)};
+    footprint.overhead += pendingFootprint();
+    return footprint;
+}
+
+void IndexedStore::rebuildSideCross() const
+{
+    if (elements.size() > numeric_limits<uint32_t>::max())
+    {
+        throw length_error("Too many elements for 32-bit positions");
+    }
+
+    elementsSide.clear();
+    elementsSide.reserve(elements.size());
+
+    if (elements.empty())
+    {
+        return;
+    }
+
+    uint32_t start = 0, end = static_cast<uint32_t>(elements.size() - 1);
+
+    while (start < end)
+    {
+        elementsSide.push_back(start);
+        elementsSide.push_back(end);
+
+        start++;
+        end--;
+    }
+
+    if (start == end)
+    {
+        elementsSide.push_back(start);
+    }
+}
+}
@@ -0,0 +1,79 @@
+#ifndef INDEXED_STORE_HPP
+#define INDEXED_STORE_HPP
+
+#include "BufferedStore.hpp"
+
+#include <cstdint>
+#include <atomic>
+
+namespace ariel
+{
+    /*
+     * @brief The default backend: a sorted vector of the elements plus a 32-bit position vector per derived order.
+     *
+     * The value vector is the ascending order itself, and the side-cross and prime orders hold positions into it.
+     * Those two indexes are built the first time their order is used. A built index is deliberately kept up
+     * to date by every later modification, whether or not its order is read again, until dropIndexes()
+     * releases it; containers that stop reading an order call dropIndexes() to stop paying for it.
+     * reserve() only pre-sizes the indexes that are built. Every traversal position is one or two vector lookups.
+     *
+     * Single additions and removals are buffered by BufferedStore, and the next read of an order merges the
+     * whole burst into the vectors at once, so k modifications followed by a read cost O(n + k log k).
+     */
+    class IndexedStore : public BufferedStore
+    {
+    public:
+        /*
+         * @brief Constructs an empty store allocating from a memory resource.
+         *
+         * @param resource The memory resource used for every structure of the store.
+         */
+        explicit IndexedStore(std::pmr::memory_resource* resource);
+
+        /*
+         * @brief Copies another store into the same memory resource.
+         *
+         * @param other The store to copy.
+         */
+        IndexedStore(const IndexedStore& other);
+
+        IndexedStore(IndexedStore&& other) = delete;
+        IndexedStore& operator=(const IndexedStore& other) = delete;
+        IndexedStore& operator=(IndexedStore&& other) = delete;
+        ~IndexedStore() override = default;
+
+        std::shared_ptr<ElementStore> clone() const override;
+        StorageBackend backend() const override;
+        std::pmr::memory_resource* resource() const override;
+        size_t count(TraversalMode mode) const override;
+        int at(TraversalMode mode, size_t index) const override;
+        void assign(std::span<const int> sorted, std::span<const int> primes) override;
+        void reserve(size_t elements) override;
+        void shrinkToFit() override;
+        size_t capacity() const override;
+        size_t rank(TraversalMode mode, int element) const override;
+        MemoryFootprint memoryFootprint() const override;
+        void dropIndexes() override;
+        void prepare(TraversalMode mode) const override;
+
+    protected:
+        bool containsCommitted(int element) const override;
+        size_t merge(const std::vector<int>& added, const std::vector<int>& removed) const override;
+
+    private:
+        mutable std::pmr::vector<int> elements;          // The unique elements, in ascending order, once committed
+        mutable std::pmr::vector<uint32_t> elementsSide;  // Positions of the elements in a side-to-side manner, once built
+        mutable std::pmr::vector<uint32_t> elementsP;     // Ascending positions of the prime elements, once built
+        mutable std::atomic<bool> sideReady{false};       // True while elementsSide is built and maintained
+        mutable std::atomic<bool> primeReady{false};      // True while elementsP is built and maintained
+
+        /*
+         * @brief Rebuilds the side-cross order from the number of elements.
+         *
+         * @throws std::length_error If the elements no longer fit 32-bit positions.
+         */
+        void rebuildSideCross() const;
+    };
+}
+
+#endif
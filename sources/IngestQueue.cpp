@@ -0,0 +1,164 @@
+#include "IngestQueue.hpp"
+
+#include <unordered_map>
+
+using namespace std;
+
+
+namespace ariel{
+IngestQueue::IngestQueue(MagicalContainer &container)
+    : container(container), applier(&IngestQueue::run, this) {}
+
+IngestQueue::~IngestQueue()
+{
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wakeUp.notify_one();
+    applier.join();
+}
+
+void IngestQueue::add(int element)
+{
+    push(element, true);
+}
+
+void IngestQueue::remove(int element)
+{
+    push(element, false);
+}
+
+void IngestQueue::flush()
+{
+    uint64_t target = pushed.load();
+
+    unique_lock<mutex> lock(stateMutex);
+    wakeUp.notify_one();
+    progress.wait(lock, [this, target] { return applied >= target; });
+    rethrowFailure();
+}
+
+unique_lock<mutex> IngestQueue::lock()
+{
+    return unique_lock<mutex>(containerMutex);
+}
+
+void IngestQueue::push(int element, bool addition)
+{
+    if (failed.load(memory_order_acquire))
+    {
+        lock_guard<mutex> lock(stateMutex);
+        rethrowFailure();
+    }
+
+    auto *operation = new Operation{element, addition, nullptr};
+    Operation *previous = pending.load(memory_order_relaxed);
+
+    do
+    {
+        operation->next = previous;
+    } while (!pending.compare_exchange_weak(previous, operation, memory_order_release, memory_order_relaxed));
+
+    pushed.fetch_add(1);
+
+    // Only the push that makes the list non-empty has to wake the applier
+    if (previous == nullptr)
+    {
+        lock_guard<mutex> lock(stateMutex);
+        wakeUp.notify_one();
+    }
+}
+
+bool IngestQueue::applyPending()
+{
+    Operation *operation = pending.exchange(nullptr, memory_order_acquire);
+
+    if (operation == nullptr)
+    {
+        return false;
+    }
+
+    // The list runs from newest to oldest, so the first operation seen for an element is the one that wins
+    unordered_map<int, bool> latest;
+    uint64_t count = 0;
+    exception_ptr failure;
+
+    try
+    {
+        while (operation != nullptr)
+        {
+            latest.emplace(operation->element, operation->addition);
+
+            Operation *next = operation->next;
+            delete operation;
+            operation = next;
+            ++count;
+        }
+
+        vector<int> additions, removals;
+        for (const auto &[element, addition] : latest)
+        {
+            (addition ? additions : removals).push_back(element);
+        }
+
+        lock_guard<mutex> lock(containerMutex);
+        container.applyBatch(additions, removals);
+    }
+    catch (...)
+    {
+        // The applier thread cannot throw, so the failure waits for the producers
+        failure = current_exception();
+    }
+
+    while (operation != nullptr)
+    {
+        Operation *next = operation->next;
+        delete operation;
+        operation = next;
+        ++count;
+    }
+
+    {
+        lock_guard<mutex> lock(stateMutex);
+        applied += count;
+        if (failure && !error)
+        {
+            error = failure;
+            failed.store(true, memory_order_release);
+        }
+    }
+    progress.notify_all();
+
+    return true;
+}
+
+void IngestQueue::rethrowFailure()
+{
+    if (error)
+    {
+        exception_ptr failure = error;
+        error = nullptr;
+        failed.store(false, memory_order_relaxed);
+        rethrow_exception(failure);
+    }
+}
+
+void IngestQueue::run()
+{
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(stateMutex);
+            wakeUp.wait(lock, [this] { return stopping || pending.load() != nullptr; });
+
+            if (stopping && pending.load() == nullptr)
+            {
+                return;
+            }
+        }
+
+        applyPending();
+    }
+}
+}
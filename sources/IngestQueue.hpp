@@ -0,0 +1,133 @@
+#ifndef INGEST_QUEUE_HPP
+#define INGEST_QUEUE_HPP
+
+#include "MagicalContainer.hpp"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+
+namespace ariel
+{
+    /*
+     * @brief A write-combining front-end that lets many threads add and remove elements of one container.
+     *
+     * Producers push operations onto a lock-free list. A single applier thread takes the whole list at once,
+     * keeps only the last operation pushed for every element and hands the result to
+     * MagicalContainer::applyBatch, so a burst of operations pays for one index rebuild.
+     *
+     * While operations are pending the container must only be accessed under lock().
+     */
+    class IngestQueue
+    {
+    public:
+        /*
+         * @brief Constructs a queue feeding a container and starts its applier thread.
+         *
+         * @param container The container the operations are applied to. It must outlive the queue.
+         */
+        explicit IngestQueue(MagicalContainer& container);
+
+        /*
+         * @brief Applies the pending operations and stops the applier thread.
+         */
+        ~IngestQueue();
+
+        IngestQueue(const IngestQueue& other) = delete;
+        IngestQueue(IngestQueue&& other) = delete;
+        IngestQueue& operator=(const IngestQueue& other) = delete;
+        IngestQueue& operator=(IngestQueue&& other) = delete;
+
+        /*
+         * @brief Queues the addition of an element. Safe to call from any thread.
+         *
+         * @param element The element to add.
+         * @throws The failure of an earlier batch that no call has reported yet; this element is not queued.
+         */
+        void add(int element);
+
+        /*
+         * @brief Queues the removal of an element. Safe to call from any thread.
+         *
+         * Removing an element that is not in the container when the batch is applied is ignored.
+         *
+         * @param element The element to remove.
+         * @throws The failure of an earlier batch that no call has reported yet; this element is not queued.
+         */
+        void remove(int element);
+
+        /*
+         * @brief Waits until every operation queued before the call has been applied.
+         *
+         * A batch that fails, for example when the container cannot allocate, is dropped and may be partly
+         * applied. Its exception is reported once, by the next flush() or the next add() or remove().
+         *
+         * Must not be called while the calling thread holds the lock returned by lock(): the applier needs
+         * that lock to apply the operations being waited for, so the call would never return.
+         *
+         * @throws The failure of a batch not reported yet.
+         */
+        void flush();
+
+        /*
+         * @brief Locks the container against the applier thread.
+         *
+         * Release the lock before calling flush(), which waits for the applier and would deadlock otherwise.
+         * add() and remove() may be called while it is held.
+         *
+         * @return A lock that keeps batches from being applied while it is held.
+         */
+        std::unique_lock<std::mutex> lock();
+
+    private:
+        struct Operation
+        {
+            int element;        // The element the operation refers to
+            bool addition;      // True for addElement, false for removeElement
+            Operation* next;    // The operation pushed before this one
+        };
+
+        MagicalContainer& container;            // The container the batches are applied to
+        std::atomic<Operation*> pending{nullptr};  // Most recently pushed operation, linked to the older ones
+        std::atomic<uint64_t> pushed{0};        // Operations pushed so far
+        uint64_t applied = 0;                   // Operations applied so far, guarded by stateMutex
+        bool stopping = false;                  // Set when the queue is destroyed, guarded by stateMutex
+        std::mutex containerMutex;              // Held while a batch is applied
+        std::mutex stateMutex;                  // Guards the applier's wake-up and progress
+        std::condition_variable wakeUp;         // Signals the applier that operations arrived
+        std::condition_variable progress;       // Signals flush() that a batch was applied
+        std::exception_ptr error;               // The first failure of a batch not reported yet, guarded by stateMutex
+        std::atomic<bool> failed{false};        // True while error holds a failure
+        std::thread applier;                    // The thread applying the batches
+
+        /*
+         * @brief Pushes an operation onto the pending list.
+         *
+         * @param element The element the operation refers to.
+         * @param addition True for an addition, false for a removal.
+         */
+        void push(int element, bool addition);
+
+        /*
+         * @brief Takes every pending operation and applies the coalesced batch.
+         *
+         * @return True if any operation was applied.
+         */
+        bool applyPending();
+
+        /*
+         * @brief Rethrows and clears the failure of a batch, if any. Called with stateMutex held.
+         */
+        void rethrowFailure();
+
+        /*
+         * @brief The loop of the applier thread.
+         */
+        void run();
+    };
+}
+
+#endif
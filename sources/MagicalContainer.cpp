@@ -1,130 +1,618 @@
 #include "MagicalContainer.hpp"
+#include "ContainerFile.hpp"
+#include "TraversalExport.hpp"
+#include "RangeView.hpp"
+
+#include <bit>
+#include <utility>
+#include <limits>
 
 using namespace std;
 
 
 namespace ariel{
-bool MagicalContainer::isPrime(int num)
+MagicalContainer::MagicalContainer()
+    : MagicalContainer(pmr::get_default_resource()) {}
+
+MagicalContainer::MagicalContainer(pmr::memory_resource *resource)
+    : MagicalContainer(StorageBackend::Indexed, resource) {}
+
+MagicalContainer::MagicalContainer(StorageBackend backend, pmr::memory_resource *resource)
+    : memory(resource), layout(backend) {}
+
+MagicalContainer::MagicalContainer(shared_ptr<ElementStore> store)
+    : storage(move(store)), memory(storage->resource()), layout(storage->backend()) {}
+
+MagicalContainer::MagicalContainer(MagicalContainer &&other) noexcept
+    : storage(move(other.storage)), memory(other.memory), inlineValues(other.inlineValues),
+      inlinePrimes(exchange(other.inlinePrimes, 0)), inlineSize(exchange(other.inlineSize, 0)),
+      layout(exchange(other.layout, StorageBackend::Indexed)) {}
+
+MagicalContainer &MagicalContainer::operator=(MagicalContainer &&other) noexcept
+{
+    if (this != &other)
+    {
+        storage = move(other.storage);
+        memory = other.memory;
+        inlineValues = other.inlineValues;
+        inlinePrimes = exchange(other.inlinePrimes, 0);
+        inlineSize = exchange(other.inlineSize, 0);
+        // A moved-from container is empty and writable, so it must not keep a read-only layout
+        layout = exchange(other.layout, StorageBackend::Indexed);
+    }
+
+    return *this;
+}
+
+void MagicalContainer::swap(MagicalContainer &other) noexcept
 {
-    if (num < 0)
-        num = -num;
+    using std::swap;
+
+    storage.swap(other.storage);
+    swap(memory, other.memory);
+    swap(inlineValues, other.inlineValues);
+    swap(inlinePrimes, other.inlinePrimes);
+    swap(inlineSize, other.inlineSize);
+    swap(layout, other.layout);
+}
 
-    if (num <= 1)
+ElementStore &MagicalContainer::writable()
+{
+    if (!storage)
     {
-        return false;
+        spill();
     }
+    else if (storage.use_count() > 1)
+    {
+        storage = storage->clone();
+    }
+
+    return *storage;
+}
 
-    for (int i = 2; i <= sqrt(num); ++i)
+void MagicalContainer::spill()
+{
+    array<int, InlineCapacity> primes{};
+    size_t primeCount = 0;
+    for (size_t index = 0; index < inlineSize; ++index)
     {
-        if (num % i == 0)
+        if ((inlinePrimes >> index) & 1U)
         {
-            return false;
+            primes[primeCount++] = inlineValues[index];
         }
     }
 
+    shared_ptr<ElementStore> spilled = ElementStore::create(layout, memory);
+    spilled->assign(span<const int>(inlineValues.data(), inlineSize), span<const int>(primes.data(), primeCount));
+    storage = move(spilled);
+    inlineSize = 0;
+    inlinePrimes = 0;
+}
+
+size_t MagicalContainer::inlinePosition(int element) const
+{
+    return static_cast<size_t>(lower_bound(inlineValues.begin(), inlineValues.begin() + inlineSize, element) - inlineValues.begin());
+}
+
+bool MagicalContainer::inlineInsert(int element)
+{
+    size_t position = inlinePosition(element);
+    if (position < inlineSize && inlineValues[position] == element)
+    {
+        return true;
+    }
+
+    if (inlineSize == InlineCapacity)
+    {
+        return false;
+    }
+
+    copy_backward(inlineValues.begin() + static_cast<ptrdiff_t>(position), inlineValues.begin() + inlineSize, inlineValues.begin() + inlineSize + 1);
+    inlineValues[position] = element;
+    ++inlineSize;
+
+    // Prime bits at and after the position move one up, making room for the new element's bit
+    auto below = static_cast<uint16_t>((1U << position) - 1);
+    auto prime = static_cast<uint16_t>(ElementStore::isPrime(element) ? 1U << position : 0U);
+    inlinePrimes = static_cast<uint16_t>((inlinePrimes & below) | ((inlinePrimes & ~below) << 1) | prime);
     return true;
 }
 
+bool MagicalContainer::inlineErase(int element)
+{
+    size_t position = inlinePosition(element);
+    if (position == inlineSize || inlineValues[position] != element)
+    {
+        return false;
+    }
+
+    copy(inlineValues.begin() + static_cast<ptrdiff_t>(position) + 1, inlineValues.begin() + inlineSize, inlineValues.begin() + static_cast<ptrdiff_t>(position));
+    --inlineSize;
+
+    auto below = static_cast<uint16_t>((1U << position) - 1);
+    auto above = static_cast<uint16_t>(~((1U << (position + 1)) - 1));
+    inlinePrimes = static_cast<uint16_t>((inlinePrimes & below) | ((inlinePrimes & above) >> 1));
+    return true;
+}
+
+void MagicalContainer::replace(span<const int> sorted, span<const int> primes)
+{
+    // Loading, assigning and merging all end here, and none of them may turn a mapped container writable
+    if (layout == StorageBackend::Mapped)
+    {
+        throw runtime_error("Error: mapped container is read-only");
+    }
+
+    if (sorted.size() > InlineCapacity)
+    {
+        shared_ptr<ElementStore> replaced = ElementStore::create(layout, memory);
+        replaced->assign(sorted, primes);
+        storage = move(replaced);
+        return;
+    }
+
+    storage.reset();
+    copy(sorted.begin(), sorted.end(), inlineValues.begin());
+    inlineSize = static_cast<uint8_t>(sorted.size());
+    inlinePrimes = 0;
+
+    auto it_prime = primes.begin();
+    for (size_t index = 0; index < sorted.size() && it_prime != primes.end(); ++index)
+    {
+        if (sorted[index] == *it_prime)
+        {
+            inlinePrimes = static_cast<uint16_t>(inlinePrimes | 1U << index);
+            ++it_prime;
+        }
+    }
+}
+
 void MagicalContainer::addElement(int element)
 {
-    auto in = elements.insert(element);
+    if (layout == StorageBackend::Mapped)
+    {
+        throw runtime_error("Error: mapped container is read-only");
+    }
+
+    if (!storage)
+    {
+        // A full inline array spills, and the new element goes into the store
+        if (!inlineInsert(element))
+        {
+            writable().insert(element);
+        }
+        return;
+    }
 
-    if (in.second)
+    if (!storage->contains(element))
     {
-        const int *address = &(*in.first);
+        writable().insert(element);
+    }
+}
+
+
+void MagicalContainer::removeElement(int element)
+{
+    if (layout == StorageBackend::Mapped)
+    {
+        throw runtime_error("Error: mapped container is read-only");
+    }
+
+    if (!storage)
+    {
+        if (!inlineErase(element))
+        {
+            throw runtime_error("Error: element not found");
+        }
+        return;
+    }
 
-        elementsAsc.insert(upper_bound(elementsAsc.begin(), elementsAsc.end(), address, [](const int* a, const int* b) { return *a<*b;}), address);
+    if (!storage->contains(element))
+    {
+        throw runtime_error("Error: element not found");
+    }
 
-        elementsSide.clear();
-        elementsSide.reserve(elementsAsc.size());
+    writable().erase(element);
+}
 
-        size_t start = 0, end = elementsAsc.size() - 1;
+void MagicalContainer::applyBatch(const vector<int> &additions, const vector<int> &removals)
+{
+    if (!storage)
+    {
+        for (int element : removals)
+        {
+            inlineErase(element);
+        }
 
-        if (isPrime(element))
+        // Stay inline while the additions fit, then hand the rest to a real store in one batch
+        auto it_addition = additions.begin();
+        while (it_addition != additions.end() && inlineInsert(*it_addition))
         {
-            elementsP.insert(upper_bound(elementsP.begin(), elementsP.end(), address, [](const int* a, const int* b) { return *a<*b;}), address);
+            ++it_addition;
         }
 
-        if (size() == 1)
+        if (it_addition == additions.end())
         {
-            elementsSide.push_back(elementsAsc.front());
             return;
         }
 
-        while (start <= end && end != 0)
+        writable().applyBatch(vector<int>(it_addition, additions.end()), {});
+        return;
+    }
+
+    writable().applyBatch(additions, removals);
+}
+
+void MagicalContainer::assignSorted(span<const int> sorted)
+{
+    vector<int> primes;
+    for (size_t index = 0; index < sorted.size(); ++index)
+    {
+        if (index > 0 && sorted[index] <= sorted[index - 1])
+        {
+            throw invalid_argument("Error: elements are not strictly ascending");
+        }
+
+        if (ElementStore::isPrime(sorted[index]))
         {
-            elementsSide.push_back(elementsAsc.at(start));
+            primes.push_back(sorted[index]);
+        }
+    }
+
+    replace(sorted, primes);
+}
+
+MagicalContainer MagicalContainer::fromSorted(span<const int> sorted, StorageBackend backend, pmr::memory_resource *resource)
+{
+    MagicalContainer container(backend, resource);
+    container.assignSorted(sorted);
+    return container;
+}
+
+void MagicalContainer::unionWith(const MagicalContainer &other)
+{
+    mergeWith(other, [](bool inFirst, bool inSecond) { return inFirst || inSecond; });
+}
+
+void MagicalContainer::intersectWith(const MagicalContainer &other)
+{
+    mergeWith(other, [](bool inFirst, bool inSecond) { return inFirst && inSecond; });
+}
+
+void MagicalContainer::subtract(const MagicalContainer &other)
+{
+    mergeWith(other, [](bool inFirst, bool inSecond) { return inFirst && !inSecond; });
+}
+
+MagicalContainer MagicalContainer::setUnion(const MagicalContainer &first, const MagicalContainer &second)
+{
+    return merged(first, second, [](bool inFirst, bool inSecond) { return inFirst || inSecond; });
+}
 
-            if (start != end)
+MagicalContainer MagicalContainer::setIntersection(const MagicalContainer &first, const MagicalContainer &second)
+{
+    return merged(first, second, [](bool inFirst, bool inSecond) { return inFirst && inSecond; });
+}
+
+MagicalContainer MagicalContainer::setDifference(const MagicalContainer &first, const MagicalContainer &second)
+{
+    return merged(first, second, [](bool inFirst, bool inSecond) { return inFirst && !inSecond; });
+}
+
+void MagicalContainer::mergeOrders(const MagicalContainer &first, const MagicalContainer &second, bool (*keep)(bool, bool),
+                                   vector<int> &sorted, vector<int> &primes)
+{
+    // Primality belongs to the value, so the primes of the result are the same merge of the two prime orders
+    auto merge = [&first, &second, keep](TraversalMode mode, vector<int> &result)
+    {
+        size_t firstCount = first.count(mode), secondCount = second.count(mode);
+        size_t firstIndex = 0, secondIndex = 0;
+        result.clear();
+        result.reserve(keep(false, true) ? firstCount + secondCount : firstCount);
+
+        while (firstIndex < firstCount || secondIndex < secondCount)
+        {
+            // Past the end of the first order, an intersection or difference keeps nothing more
+            if (firstIndex == firstCount && !keep(false, true))
             {
-                elementsSide.push_back(elementsAsc.at(end));
+                break;
             }
 
-            start++;
-            end--;
+            bool inFirst = firstIndex < firstCount, inSecond = secondIndex < secondCount;
+            int element = 0;
+            if (inFirst && inSecond)
+            {
+                int firstElement = first.at(mode, firstIndex), secondElement = second.at(mode, secondIndex);
+                inFirst = firstElement <= secondElement;
+                inSecond = secondElement <= firstElement;
+                element = min(firstElement, secondElement);
+            }
+            else
+            {
+                element = inFirst ? first.at(mode, firstIndex) : second.at(mode, secondIndex);
+            }
+
+            if (keep(inFirst, inSecond))
+            {
+                result.push_back(element);
+            }
+            firstIndex += inFirst ? 1U : 0U;
+            secondIndex += inSecond ? 1U : 0U;
         }
-    }
-}
+    };
 
+    merge(TraversalMode::Ascending, sorted);
+    merge(TraversalMode::Prime, primes);
+}
 
-void MagicalContainer::removeElement(int element)
+MagicalContainer MagicalContainer::merged(const MagicalContainer &first, const MagicalContainer &second, bool (*keep)(bool, bool))
 {
-    auto it = elements.find(element);
+    vector<int> sorted, primes;
+    mergeOrders(first, second, keep, sorted, primes);
+
+    // A mapped container is read-only, so its results live in the default backend
+    MagicalContainer result(first.layout == StorageBackend::Mapped ? StorageBackend::Indexed : first.layout, first.memory);
+    result.replace(sorted, primes);
+    return result;
+}
 
-    if (it == elements.end())
+void MagicalContainer::mergeWith(const MagicalContainer &other, bool (*keep)(bool, bool))
+{
+    if (layout == StorageBackend::Mapped)
     {
-        throw runtime_error("Error: element not found");
+        throw runtime_error("Error: mapped container is read-only");
     }
 
-    const int *address = &(*it);
-    elements.erase(it);
+    vector<int> sorted, primes;
+    mergeOrders(*this, other, keep, sorted, primes);
+    replace(sorted, primes);
+}
+
+size_t MagicalContainer::size() const
+{
+    return storage ? storage->size() : inlineSize;
+}
 
-    if (isPrime(element))
+MagicalContainer MagicalContainer::snapshot() const
+{
+    return *this;
+}
+
+pmr::memory_resource *MagicalContainer::resource() const
+{
+    return memory;
+}
+
+StorageBackend MagicalContainer::backend() const
+{
+    return layout;
+}
+
+void MagicalContainer::useBackend(StorageBackend backend)
+{
+    if (backend == layout)
     {
-        auto it_prime = find(elementsP.begin(), elementsP.end(), address);
-        if (it_prime != elementsP.end())
-        {
-            elementsP.erase(it_prime);
-        }
+        return;
     }
 
-    auto it_ascending = find(elementsAsc.begin(), elementsAsc.end(), address);
-    if (it_ascending != elementsAsc.end())
+    layout = backend;
+    if (!storage)
     {
-        elementsAsc.erase(it_ascending);
+        return;
     }
 
-    elementsSide.clear();
-    elementsSide.reserve(elementsAsc.size());
+    shared_ptr<ElementStore> converted = ElementStore::create(backend, memory);
+    converted->assign(storage->elements(TraversalMode::Ascending), storage->elements(TraversalMode::Prime));
+    storage = move(converted);
+}
+
+void MagicalContainer::reserve(size_t elements)
+{
+    if (storage || elements > InlineCapacity)
+    {
+        writable().reserve(elements);
+    }
+}
 
-    if (size() == 0)
+void MagicalContainer::shrinkToFit()
+{
+    if (!storage)
+    {
         return;
+    }
 
-    else if (size() == 1)
+    // A read-only store never moves inline, since that would make it writable
+    if (storage->size() > InlineCapacity || layout == StorageBackend::Mapped)
     {
-        elementsSide.push_back(elementsAsc.front());
+        writable().shrinkToFit();
         return;
     }
 
-    size_t start = 0, end = elementsAsc.size() - 1;
+    // Few enough elements to move back inline and release the store
+    replace(storage->elements(TraversalMode::Ascending), storage->elements(TraversalMode::Prime));
+}
+
+size_t MagicalContainer::capacity() const
+{
+    return storage ? storage->capacity() : InlineCapacity;
+}
+
+MemoryFootprint MagicalContainer::memoryFootprint() const
+{
+    if (storage)
+    {
+        return storage->memoryFootprint();
+    }
+
+    // Inline elements live in the container object, so nothing is allocated
+    MemoryFootprint footprint;
+    footprint.values.used = inlineSize * sizeof(int);
+    return footprint;
+}
+
+void MagicalContainer::dropIndexes()
+{
+    if (storage && storage.use_count() == 1)
+    {
+        storage->dropIndexes();
+    }
+}
 
-    while (start <= end && end != 0)
+void MagicalContainer::commit() const
+{
+    if (storage)
     {
-        elementsSide.push_back(elementsAsc.at(start));
+        storage->commit();
+    }
+}
+
+void MagicalContainer::save(const string &path) const
+{
+    ContainerFile::save(*this, path);
+}
 
-        if (start != end)
+void MagicalContainer::load(const string &path)
+{
+    ContainerFile::load(*this, path);
+}
+
+size_t MagicalContainer::exportTo(TraversalMode mode, int descriptor, ExportFormat format) const
+{
+    return TraversalExport::write(*this, mode, descriptor, format);
+}
+
+size_t MagicalContainer::exportTo(TraversalMode mode, const string &path, ExportFormat format) const
+{
+    return TraversalExport::write(*this, mode, path, format);
+}
+
+size_t MagicalContainer::count(TraversalMode mode) const
+{
+    if (storage)
+    {
+        return storage->count(mode);
+    }
+
+    return mode == TraversalMode::Prime ? static_cast<size_t>(popcount(inlinePrimes)) : inlineSize;
+}
+
+int MagicalContainer::at(TraversalMode mode, size_t index) const
+{
+    if (storage)
+    {
+        return storage->at(mode, index);
+    }
+
+    if (index >= count(mode))
+    {
+        throw out_of_range("Iterator out of range");
+    }
+
+    switch (mode)
+    {
+    case TraversalMode::Ascending:
+        return inlineValues[index];
+    case TraversalMode::SideCross:
+        return inlineValues[ElementStore::crossToAscending(index, inlineSize)];
+    case TraversalMode::Prime:
+    {
+        unsigned int bits = inlinePrimes;
+        for (; index > 0; --index)
         {
-            elementsSide.push_back(elementsAsc.at(end));
+            bits &= bits - 1;
         }
+        return inlineValues[static_cast<size_t>(countr_zero(bits))];
+    }
+    }
+
+    throw invalid_argument("Unknown traversal mode");
+}
 
-        start++;
-        end--;
+size_t MagicalContainer::rank(TraversalMode mode, int element, bool inclusive) const
+{
+    if (mode == TraversalMode::SideCross)
+    {
+        throw invalid_argument("Error: the side-cross order is not sorted");
     }
+
+    // Over integers, counting up to and including a value is counting below its successor
+    if (inclusive)
+    {
+        if (element == numeric_limits<int>::max())
+        {
+            return count(mode);
+        }
+        ++element;
+    }
+
+    if (storage)
+    {
+        return storage->rank(mode, element);
+    }
+
+    auto position = static_cast<size_t>(lower_bound(inlineValues.begin(), inlineValues.begin() + inlineSize, element) - inlineValues.begin());
+    if (mode == TraversalMode::Ascending)
+    {
+        return position;
+    }
+
+    return static_cast<size_t>(popcount(static_cast<unsigned int>(inlinePrimes) & ((1U << position) - 1)));
 }
 
-size_t MagicalContainer::size() const
+size_t MagicalContainer::countInRange(int low, int high) const
+{
+    return low > high ? 0 : rank(TraversalMode::Ascending, high, true) - rank(TraversalMode::Ascending, low);
+}
+
+size_t MagicalContainer::primeCountInRange(int low, int high) const
+{
+    return low > high ? 0 : rank(TraversalMode::Prime, high, true) - rank(TraversalMode::Prime, low);
+}
+
+RangeView MagicalContainer::range(int low, int high) const
+{
+    return RangeView(snapshot(), low, high);
+}
+
+bool MagicalContainer::contains(int element) const
 {
-    return elements.size();
+    if (storage)
+    {
+        return storage->contains(element);
+    }
+
+    return binary_search(inlineValues.begin(), inlineValues.begin() + inlineSize, element);
+}
+
+MagicalContainer::AscendingIterator MagicalContainer::find(int element)
+{
+    size_t position = rank(TraversalMode::Ascending, element);
+    if (position < count(TraversalMode::Ascending) && at(TraversalMode::Ascending, position) == element)
+    {
+        return AscendingIterator(*this, position);
+    }
+
+    return AscendingIterator(*this, count(TraversalMode::Ascending));
+}
+
+MagicalContainer::AscendingIterator MagicalContainer::lowerBound(int element)
+{
+    return AscendingIterator(*this, rank(TraversalMode::Ascending, element));
+}
+
+MagicalContainer::AscendingIterator MagicalContainer::upperBound(int element)
+{
+    return AscendingIterator(*this, rank(TraversalMode::Ascending, element, true));
+}
+
+MagicalContainer::PrimeIterator MagicalContainer::primeLowerBound(int element)
+{
+    return PrimeIterator(*this, rank(TraversalMode::Prime, element));
+}
+
+MagicalContainer::PrimeIterator MagicalContainer::primeUpperBound(int element)
+{
+    return PrimeIterator(*this, rank(TraversalMode::Prime, element, true));
 }
 
 MagicalContainer::AscendingIterator::AscendingIterator(MagicalContainer &container, size_t index)
@@ -154,15 +642,10 @@ MagicalContainer::AscendingIterator &MagicalContainer::AscendingIterator::operat
     return *this;
 }
 
-MagicalContainer::AscendingIterator &MagicalContainer::AscendingIterator::operator=(AscendingIterator &&other) noexcept
+MagicalContainer::AscendingIterator &MagicalContainer::AscendingIterator::operator=(AscendingIterator &&other)
 {
-    if (this != &other)
-    {
-        container = move(other.container);
-        index = move(other.index);
-    }
-
-    return *this;
+    // The container is held by reference, so only the position can move
+    return *this = static_cast<const AscendingIterator &>(other);
 }
 
 bool MagicalContainer::AscendingIterator::operator==(const AscendingIterator &other) const
@@ -203,17 +686,12 @@ bool MagicalContainer::AscendingIterator::operator<(const AscendingIterator &oth
 
 int MagicalContainer::AscendingIterator::operator*() const
 {
-    if (index >= container.elementsAsc.size())
-    {
-        throw out_of_range("Iterator out of range");
-    }
-
-    return *(container.elementsAsc.at(index));
+    return container.at(TraversalMode::Ascending, index);
 }
 
 MagicalContainer::AscendingIterator &MagicalContainer::AscendingIterator::operator++()
 {
-    if (index >= container.elementsAsc.size())
+    if (index >= container.count(TraversalMode::Ascending))
     {
         throw runtime_error("Iterator out of range");
     }
@@ -223,10 +701,22 @@ MagicalContainer::AscendingIterator &MagicalContainer::AscendingIterator::operat
 }
 
 MagicalContainer::SideCrossIterator::SideCrossIterator(MagicalContainer &container, size_t index)
-    : container(container), index(index) {}
+    : container(container), index(index)
+{
+    if (container.storage)
+    {
+        container.storage->prepare(TraversalMode::SideCross);
+    }
+}
 
 MagicalContainer::SideCrossIterator::SideCrossIterator(MagicalContainer &container)
-    : container(container), index(0) {}
+    : container(container), index(0)
+{
+    if (container.storage)
+    {
+        container.storage->prepare(TraversalMode::SideCross);
+    }
+}
 
 MagicalContainer::SideCrossIterator::SideCrossIterator(const SideCrossIterator &other)
     : container(other.container), index(other.index) {}
@@ -248,15 +738,10 @@ MagicalContainer::SideCrossIterator &MagicalContainer::SideCrossIterator::operat
     return *this;
 }
 
-MagicalContainer::SideCrossIterator &MagicalContainer::SideCrossIterator::operator=(SideCrossIterator &&other) noexcept
+MagicalContainer::SideCrossIterator &MagicalContainer::SideCrossIterator::operator=(SideCrossIterator &&other)
 {
-    if (this != &other)
-    {
-        container = move(other.container);
-        index = move(other.index);
-    }
-
-    return *this;
+    // The container is held by reference, so only the position can move
+    return *this = static_cast<const SideCrossIterator &>(other);
 }
 
 bool MagicalContainer::SideCrossIterator::operator==(const SideCrossIterator &other) const
@@ -297,17 +782,12 @@ bool MagicalContainer::SideCrossIterator::operator<(const SideCrossIterator &oth
 
 int MagicalContainer::SideCrossIterator::operator*() const
 {
-    if (index >= container.elementsSide.size())
-    {
-        throw out_of_range("Iterator out of range");
-    }
-
-    return *(container.elementsSide.at(index));
+    return container.at(TraversalMode::SideCross, index);
 }
 
 MagicalContainer::SideCrossIterator &MagicalContainer::SideCrossIterator::operator++()
 {
-    if (index >= container.elementsSide.size())
+    if (index >= container.count(TraversalMode::SideCross))
     {
         throw runtime_error("Iterator out of range");
     }
@@ -317,10 +797,22 @@ MagicalContainer::SideCrossIterator &MagicalContainer::SideCrossIterator::operat
 }
 
 MagicalContainer::PrimeIterator::PrimeIterator(MagicalContainer &container, size_t index)
-    : container(container), index(index) {}
+    : container(container), index(index)
+{
+    if (container.storage)
+    {
+        container.storage->prepare(TraversalMode::Prime);
+    }
+}
 
 MagicalContainer::PrimeIterator::PrimeIterator(MagicalContainer &container)
-    : container(container), index(0) {}
+    : container(container), index(0)
+{
+    if (container.storage)
+    {
+        container.storage->prepare(TraversalMode::Prime);
+    }
+}
 
 MagicalContainer::PrimeIterator::PrimeIterator(const PrimeIterator &other)
     : container(other.container), index(other.index) {}
@@ -343,15 +835,10 @@ MagicalContainer::PrimeIterator &MagicalContainer::PrimeIterator::operator=(cons
     return *this;
 }
 
-MagicalContainer::PrimeIterator &MagicalContainer::PrimeIterator::operator=(PrimeIterator &&other) noexcept
+MagicalContainer::PrimeIterator &MagicalContainer::PrimeIterator::operator=(PrimeIterator &&other)
 {
-    if (this != &other)
-    {
-        container = move(other.container);
-        index = move(other.index);
-    }
-
-    return *this;
+    // The container is held by reference, so only the position can move
+    return *this = static_cast<const PrimeIterator &>(other);
 }
 
 bool MagicalContainer::PrimeIterator::operator==(const PrimeIterator &other) const
@@ -395,17 +882,12 @@ bool MagicalContainer::PrimeIterator::operator<(const PrimeIterator &other) cons
 
 int MagicalContainer::PrimeIterator::operator*() const
 {
-    if (index >= container.elementsP.size())
-    {
-        throw out_of_range("Iterator out of range");
-    }
-
-    return *(container.elementsP.at(index));
+    return container.at(TraversalMode::Prime, index);
 }
 
 MagicalContainer::PrimeIterator &MagicalContainer::PrimeIterator::operator++()
 {
-    if (index >= container.elementsP.size())
+    if (index >= container.count(TraversalMode::Prime))
     {
         throw runtime_error("Iterator out of range");
     }
@@ -1,40 +1,215 @@
 #ifndef MAGICAL_CONTAINER_HPP
 #define MAGICAL_CONTAINER_HPP
 
+#include "ElementStore.hpp"
+
 #include <vector>
-#include <set>
+#include <span>
+#include <string>
+#include <array>
+#include <cstdint>
 #include <stdexcept>
 #include <cstdlib>
 #include <memory>
 #include <algorithm>
-#include <cmath>
+#include <memory_resource>
 
 namespace ariel
 {
+    class RangeView;
+
     /*
      * @brief A magical container that stores a set of integers and provides iterators for different traversal modes.
+     *
+     * Up to InlineCapacity elements are kept inside the object, as a sorted array with one prime bit per element,
+     * so small containers never allocate. Larger containers move their elements into a store of their backend.
      */
     class MagicalContainer
     {
+    public:
+        static constexpr size_t InlineCapacity = 16;    // Elements kept inside the object before a store is allocated
+
+        class AscendingIterator;
+        class SideCrossIterator;
+        class PrimeIterator;
+
     private:
-        std::set<int> elements;                     // Set to store the unique elements
-        std::vector<const int*> elementsAsc;         // Vector to store pointers to the elements in ascending order
-        std::vector<const int*> elementsSide;        // Vector to store pointers to the elements in a side-to-side manner
-        std::vector<const int*> elementsP;           // Vector to store pointers to the prime elements
+        std::shared_ptr<ElementStore> storage;      // The current version, shared with snapshots until it is written; null while inline
+        std::pmr::memory_resource* memory;          // The memory resource every store is allocated from
+        std::array<int, InlineCapacity> inlineValues{};    // The elements in ascending order, while inline
+        uint16_t inlinePrimes = 0;                  // Bit i set if inlineValues[i] is prime, while inline
+        uint8_t inlineSize = 0;                     // The number of inline elements
+        StorageBackend layout;                      // The backend used once the elements spill out of the object
+
+        /*
+         * @brief Returns the current version for writing, copying it first if a snapshot still shares it.
+         * 
+         * Inline elements are moved into a new store first.
+         * 
+         * @return The version owned by this container alone.
+         */
+        ElementStore& writable();
+
+        /*
+         * @brief Moves the inline elements into a new store of the container's backend.
+         */
+        void spill();
+
+        /*
+         * @brief Finds the first inline element that is not smaller than a given element.
+         * 
+         * @param element The element to look for.
+         * @return Its position among the inline elements.
+         */
+        size_t inlinePosition(int element) const;
+
+        /*
+         * @brief Adds an element inline, if it is new and there is room for it.
+         * 
+         * @param element The element to add.
+         * @return False if the inline storage is full and the element is not in it yet.
+         */
+        bool inlineInsert(int element);
 
         /*
-         * @brief Checks if a number is prime.
+         * @brief Removes an inline element.
          * 
-         * @param num The number to check.
-         * @return True if the number is prime, false otherwise.
+         * @param element The element to remove.
+         * @return True if the element was removed, false if it was not there.
          */
-        static bool isPrime(int num);
+        bool inlineErase(int element);
+
+        /*
+         * @brief Replaces the contents with sorted elements whose prime subset is known, inline if they fit.
+         * 
+         * @param sorted The elements, strictly ascending.
+         * @param primes The prime elements of sorted, strictly ascending.
+         */
+        void replace(std::span<const int> sorted, std::span<const int> primes);
+
+        /*
+         * @brief Merges the ascending and prime orders of two containers.
+         * 
+         * @param first The first container.
+         * @param second The second container.
+         * @param keep Which elements to keep: keep(inFirst, inSecond) is true for an element of the result.
+         * @param sorted Receives the elements kept, in ascending order.
+         * @param primes Receives the prime elements kept, in ascending order.
+         */
+        static void mergeOrders(const MagicalContainer& first, const MagicalContainer& second, bool (*keep)(bool, bool),
+                                std::vector<int>& sorted, std::vector<int>& primes);
+
+        /*
+         * @brief Creates a container like first holding the merge of two containers.
+         */
+        static MagicalContainer merged(const MagicalContainer& first, const MagicalContainer& second, bool (*keep)(bool, bool));
+
+        /*
+         * @brief Replaces the elements with the merge of this container and another.
+         */
+        void mergeWith(const MagicalContainer& other, bool (*keep)(bool, bool));
+
+        friend class ContainerFile;
+        friend class Checkpointer;
+
+    protected:
+        /*
+         * @brief Constructs a container around an existing store.
+         * 
+         * @param store The store, which the container owns from now on.
+         */
+        explicit MagicalContainer(std::shared_ptr<ElementStore> store);
 
     public:
+        /*
+         * @brief Constructs an empty container that allocates from the default memory resource.
+         */
+        MagicalContainer();
+
+        /*
+         * @brief Constructs an empty container that allocates every internal structure from a memory resource.
+         * 
+         * The resource must outlive the container and every copy or snapshot taken from it.
+         * 
+         * @param resource The memory resource, for example a monotonic arena or a pool.
+         */
+        explicit MagicalContainer(std::pmr::memory_resource* resource);
+
+        /*
+         * @brief Constructs an empty container with a given storage backend.
+         * 
+         * @param backend The layout used to store the elements.
+         * @param resource The memory resource every internal structure is allocated from.
+         */
+        explicit MagicalContainer(StorageBackend backend, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+        /*
+         * @brief Copy constructor. The copy shares the elements until either container is modified.
+         * 
+         * The first modification copies the elements in linear time and rebuilds the indexes against the
+         * copy's own storage, so the two containers never observe each other's changes.
+         * 
+         * @param other The MagicalContainer to copy.
+         */
+        MagicalContainer(const MagicalContainer& other) = default;
+
+        /*
+         * @brief Copy assignment operator. The copy shares the elements until either container is modified.
+         * 
+         * @param other The MagicalContainer to copy.
+         * @return A reference to this container.
+         */
+        MagicalContainer& operator=(const MagicalContainer& other) = default;
+
+        /*
+         * @brief Move constructor. Takes over the elements in O(1).
+         * 
+         * The moved-from container is left empty, with its backend and memory resource.
+         * 
+         * @param other The MagicalContainer to move.
+         */
+        MagicalContainer(MagicalContainer&& other) noexcept;
+
+        /*
+         * @brief Move assignment operator. Takes over the elements in O(1).
+         * 
+         * The moved-from container is left empty, with its backend and memory resource.
+         * 
+         * @param other The MagicalContainer to move.
+         * @return A reference to this container.
+         */
+        MagicalContainer& operator=(MagicalContainer&& other) noexcept;
+
+        /*
+         * @brief Exchanges the contents of two containers in O(1).
+         * 
+         * Iterators keep referring to the container they were created with, and so see its new contents.
+         * 
+         * @param other The MagicalContainer to swap with.
+         */
+        void swap(MagicalContainer& other) noexcept;
+
+        /*
+         * @brief Exchanges the contents of two containers in O(1).
+         * 
+         * @param first The first container.
+         * @param second The second container.
+         */
+        friend void swap(MagicalContainer& first, MagicalContainer& second) noexcept
+        {
+            first.swap(second);
+        }
+
+        /*
+         * @brief Destructor for MagicalContainer.
+         */
+        ~MagicalContainer() = default;
+
         /*
          * @brief Adds an element to the container.
          * 
          * @param element The element to add.
+         * @throws std::runtime_error If this container is read-only.
          */
         void addElement(int element);
 
@@ -42,9 +217,98 @@ namespace ariel
          * @brief Removes an element from the container.
          * 
          * @param element The element to remove.
+         * @throws std::runtime_error If this container is read-only.
          */
         void removeElement(int element);
 
+        /*
+         * @brief Adds and removes many elements at once, rebuilding the traversal orders a single time.
+         * 
+         * Removals are applied before additions. Adding an element that is already present and removing
+         * an element that is not present are both ignored.
+         * 
+         * @param additions The elements to add.
+         * @param removals The elements to remove.
+         */
+        void applyBatch(const std::vector<int>& additions, const std::vector<int>& removals);
+
+        /*
+         * @brief Replaces the elements with an already sorted sequence, in linear time.
+         * 
+         * One pass checks the order and finds the primes; the store is then built from the sequence as it is,
+         * without searching for or inserting any element.
+         * 
+         * @param sorted The new elements, strictly ascending.
+         * @throws std::invalid_argument If the elements are not strictly ascending. The container is unchanged.
+         * @throws std::runtime_error If this container is read-only.
+         */
+        void assignSorted(std::span<const int> sorted);
+
+        /*
+         * @brief Creates a container from an already sorted sequence, in linear time.
+         * 
+         * @param sorted The elements, strictly ascending.
+         * @param backend The storage layout.
+         * @param resource The memory resource.
+         * @return The container.
+         * @throws std::invalid_argument If the elements are not strictly ascending.
+         */
+        static MagicalContainer fromSorted(std::span<const int> sorted, StorageBackend backend = StorageBackend::Indexed,
+                                           std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+        /*
+         * @brief Adds every element of another container, in one merge of the two ascending orders.
+         * 
+         * The prime order is merged the same way, so no element is tested for primality.
+         * 
+         * @param other The other container, which may be this one.
+         * @throws std::runtime_error If this container is read-only.
+         */
+        void unionWith(const MagicalContainer& other);
+
+        /*
+         * @brief Keeps only the elements also in another container, in one merge of the two ascending orders.
+         * 
+         * @param other The other container, which may be this one.
+         * @throws std::runtime_error If this container is read-only.
+         */
+        void intersectWith(const MagicalContainer& other);
+
+        /*
+         * @brief Removes every element of another container, in one merge of the two ascending orders.
+         * 
+         * @param other The other container, which may be this one.
+         * @throws std::runtime_error If this container is read-only.
+         */
+        void subtract(const MagicalContainer& other);
+
+        /*
+         * @brief Creates the union of two containers in linear time.
+         * 
+         * @param first The first container, whose backend and memory resource the result uses.
+         * @param second The second container.
+         * @return The elements in either container.
+         */
+        static MagicalContainer setUnion(const MagicalContainer& first, const MagicalContainer& second);
+
+        /*
+         * @brief Creates the intersection of two containers in linear time.
+         * 
+         * @param first The first container, whose backend and memory resource the result uses.
+         * @param second The second container.
+         * @return The elements in both containers.
+         */
+        static MagicalContainer setIntersection(const MagicalContainer& first, const MagicalContainer& second);
+
+        /*
+         * @brief Creates the difference of two containers in linear time.
+         * 
+         * @param first The first container, whose backend and memory resource the result uses.
+         * @param second The second container.
+         * @return The elements of the first container that are not in the second.
+         */
+        static MagicalContainer setDifference(const MagicalContainer& first, const MagicalContainer& second);
+
         /*
          * @brief Returns the number of elements in the container.
          * 
@@ -52,6 +316,239 @@ namespace ariel
          */
         size_t size() const;
 
+        /*
+         * @brief Takes a consistent, read-only view of the current contents in O(1).
+         * 
+         * The snapshot shares the elements with this container. The first modification of either one after
+         * the snapshot copies the elements, so iterators over the snapshot never see later changes and can
+         * keep running on another thread while this container is modified. snapshot() itself must not run
+         * concurrently with modifications of this container.
+         * 
+         * @return A container holding the current contents.
+         */
+        MagicalContainer snapshot() const;
+
+        /*
+         * @brief Returns the memory resource the container allocates from.
+         * 
+         * @return The memory resource.
+         */
+        std::pmr::memory_resource* resource() const;
+
+        /*
+         * @brief Returns the storage backend of the container.
+         * 
+         * @return The backend.
+         */
+        StorageBackend backend() const;
+
+        /*
+         * @brief Moves the contents to another storage backend in linear time, without retesting primality.
+         * 
+         * @param backend The new backend.
+         */
+        void useBackend(StorageBackend backend);
+
+        /*
+         * @brief Pre-sizes every internal structure for a number of elements, so loading that many
+         * elements does not reallocate.
+         * 
+         * The reservation belongs to the current version: copying it for a shared snapshot or switching
+         * backends allocates exactly what the elements need.
+         * 
+         * @param elements The number of elements to make room for.
+         */
+        void reserve(size_t elements);
+
+        /*
+         * @brief Releases the memory held beyond the current elements, for example after mass deletion.
+         * 
+         * A container that fits InlineCapacity again moves its elements back inline and frees its store.
+         */
+        void shrinkToFit();
+
+        /*
+         * @brief Returns the number of elements the container can hold without reallocating.
+         * 
+         * @return The capacity.
+         */
+        size_t capacity() const;
+
+        /*
+         * @brief Measures the memory held by the current version, per internal structure.
+         * 
+         * Containers and snapshots sharing a version each report all of it.
+         * 
+         * @return The bytes used and reserved by the value store, each traversal index and the overhead.
+         */
+        MemoryFootprint memoryFootprint() const;
+
+        /*
+         * @brief Releases the side-cross and prime indexes, for containers that are only written to for a while.
+         * 
+         * Once built, an index is maintained through every modification until this is called; it is never
+         * dropped on its own. Each index is rebuilt the next time an iterator of its order is created or the
+         * order is read.
+         * Indexes shared with a snapshot stay allocated until the snapshot is gone.
+         */
+        void dropIndexes();
+
+        /*
+         * @brief Applies the additions and removals made since the last read in one merge.
+         * 
+         * Modifications are recorded and merged on the next read of a traversal order, so iterators still
+         * see every added element. Calling commit() after a burst of writes moves that merge out of the read.
+         */
+        void commit() const;
+
+        /*
+         * @brief Writes the elements to a file in the compact binary format of ContainerFile.
+         * 
+         * @param path The file, which is replaced.
+         * @throws std::runtime_error If the file cannot be written.
+         */
+        void save(const std::string& path) const;
+
+        /*
+         * @brief Replaces the elements with a file written by save(), in one read and linear time.
+         * 
+         * The container keeps its backend and memory resource.
+         * 
+         * @param path The file.
+         * @throws std::runtime_error If the file cannot be read or is not a valid container file, or if this
+         * container is read-only.
+         */
+        void load(const std::string& path);
+
+        /*
+         * @brief Writes a traversal order to a file descriptor in large buffered blocks (TraversalExport).
+         * 
+         * @param mode The traversal mode.
+         * @param descriptor The file descriptor, for example 1 for the standard output. It is left open.
+         * @param format One decimal element per line, or consecutive little-endian 32-bit elements.
+         * @return The number of elements written.
+         * @throws std::runtime_error If a write fails.
+         */
+        size_t exportTo(TraversalMode mode, int descriptor, ExportFormat format = ExportFormat::Text) const;
+
+        /*
+         * @brief Writes a traversal order to a file in large buffered blocks (TraversalExport).
+         * 
+         * @param mode The traversal mode.
+         * @param path The file, which is replaced.
+         * @param format One decimal element per line, or consecutive little-endian 32-bit elements.
+         * @return The number of elements written.
+         * @throws std::runtime_error If the file cannot be written.
+         */
+        size_t exportTo(TraversalMode mode, const std::string& path, ExportFormat format = ExportFormat::Text) const;
+
+        /*
+         * @brief Returns the number of elements visited by a traversal mode.
+         * 
+         * @param mode The traversal mode.
+         * @return The number of positions in that traversal order.
+         */
+        size_t count(TraversalMode mode) const;
+
+        /*
+         * @brief Returns the element at a position of a traversal order.
+         * 
+         * @param mode The traversal mode.
+         * @param index The position in that traversal order.
+         * @return The element at that position.
+         * @throws std::out_of_range If the index is past the end of the traversal.
+         */
+        int at(TraversalMode mode, size_t index) const;
+
+        /*
+         * @brief Returns the number of elements of a sorted traversal order below a value, in O(log n).
+         * 
+         * @param mode The ascending or prime order.
+         * @param element The value.
+         * @param inclusive True to also count the elements equal to the value.
+         * @return The number of elements of that order less than, or not greater than, the value.
+         * @throws std::invalid_argument For the side-cross order, which is not sorted.
+         */
+        size_t rank(TraversalMode mode, int element, bool inclusive = false) const;
+
+        /*
+         * @brief Returns the number of elements in [low, high], in O(log n).
+         * 
+         * @param low The smallest value counted.
+         * @param high The largest value counted.
+         * @return The number of elements, 0 if low > high.
+         */
+        size_t countInRange(int low, int high) const;
+
+        /*
+         * @brief Returns the number of prime elements in [low, high], in O(log n).
+         * 
+         * @param low The smallest value counted.
+         * @param high The largest value counted.
+         * @return The number of prime elements, 0 if low > high.
+         */
+        size_t primeCountInRange(int low, int high) const;
+
+        /*
+         * @brief Returns a view of the elements in [low, high], traversable in every mode.
+         * 
+         * The view holds a snapshot, so later modifications of the container do not change it.
+         * Include RangeView.hpp to use it.
+         * 
+         * @param low The smallest value in the view.
+         * @param high The largest value in the view.
+         * @return The view, located with two binary searches per order.
+         */
+        RangeView range(int low, int high) const;
+
+        /*
+         * @brief Checks whether an element is in the container, in O(log n) or better depending on the backend.
+         * 
+         * @param element The element to look for.
+         * @return True if the element is in the container.
+         */
+        bool contains(int element) const;
+
+        /*
+         * @brief Finds an element, in O(log n).
+         * 
+         * @param element The element to look for.
+         * @return An AscendingIterator at the element, or at the end if it is not in the container.
+         */
+        AscendingIterator find(int element);
+
+        /*
+         * @brief Finds the first element not less than a value, in O(log n).
+         * 
+         * @param element The value.
+         * @return An AscendingIterator at that element, or at the end if there is none.
+         */
+        AscendingIterator lowerBound(int element);
+
+        /*
+         * @brief Finds the first element greater than a value, in O(log n).
+         * 
+         * @param element The value.
+         * @return An AscendingIterator at that element, or at the end if there is none.
+         */
+        AscendingIterator upperBound(int element);
+
+        /*
+         * @brief Finds the first prime element not less than a value, in O(log n).
+         * 
+         * @param element The value.
+         * @return A PrimeIterator at that element, or at the end if there is none.
+         */
+        PrimeIterator primeLowerBound(int element);
+
+        /*
+         * @brief Finds the first prime element greater than a value, in O(log n).
+         * 
+         * @param element The value.
+         * @return A PrimeIterator at that element, or at the end if there is none.
+         */
+        PrimeIterator primeUpperBound(int element);
+
         /*
          * @brief Iterator for traversing the elements in ascending order.
          */
@@ -93,12 +590,13 @@ namespace ariel
             ~AscendingIterator();
 
             /*
-             * @brief Move assignment operator for AscendingIterator.
+             * @brief Move assignment operator for AscendingIterator. Behaves like copy assignment.
              * 
              * @param other The AscendingIterator to move.
              * @return A reference to the moved AscendingIterator.
+             * @throws std::runtime_error If the iterators are not from the same container.
              */
-            AscendingIterator& operator=(AscendingIterator&& other) noexcept;
+            AscendingIterator& operator=(AscendingIterator&& other);
 
             /*
              * @brief Copy assignment operator for AscendingIterator.
@@ -171,7 +669,7 @@ namespace ariel
              */
             AscendingIterator end()
             {
-                return AscendingIterator(container, container.elementsAsc.size());
+                return AscendingIterator(container, container.count(TraversalMode::Ascending));
             }
 
         private:
@@ -221,12 +719,13 @@ namespace ariel
             ~SideCrossIterator();
 
             /*
-             * @brief Move assignment operator for SideCrossIterator.
+             * @brief Move assignment operator for SideCrossIterator. Behaves like copy assignment.
              * 
              * @param other The SideCrossIterator to move.
              * @return A reference to the moved SideCrossIterator.
+             * @throws std::runtime_error If the iterators are not from the same container.
              */
-            SideCrossIterator& operator=(SideCrossIterator&& other) noexcept;
+            SideCrossIterator& operator=(SideCrossIterator&& other);
 
             /*
              * @brief Copy assignment operator for SideCrossIterator.
@@ -299,7 +798,7 @@ namespace ariel
              */
             SideCrossIterator end()
             {
-                return SideCrossIterator(container, container.elementsSide.size());
+                return SideCrossIterator(container, container.count(TraversalMode::SideCross));
             }
 
         private:
@@ -343,12 +842,13 @@ namespace ariel
             PrimeIterator(PrimeIterator &&other) noexcept;
 
             /*
-             * @brief Move assignment operator for PrimeIterator.
+             * @brief Move assignment operator for PrimeIterator. Behaves like copy assignment.
              * 
              * @param other The PrimeIterator to move.
              * @return A reference to the moved PrimeIterator.
+             * @throws std::runtime_error If the iterators are not from the same container.
              */
-            PrimeIterator& operator=(PrimeIterator&& other) noexcept;
+            PrimeIterator& operator=(PrimeIterator&& other);
 
             /*
              * @brief Copy assignment operator for PrimeIterator.
@@ -423,7 +923,7 @@ namespace ariel
              */
             PrimeIterator end()         
             {
-                return PrimeIterator(container, container.elementsP.size());
+                return PrimeIterator(container, container.count(TraversalMode::Prime));
             }
 
         private:
@@ -431,8 +931,6 @@ namespace ariel
             size_t index;                   // Current index of the iterator
         };
     };
+}
 
-
-#endif 
-
-}
\ No newline at end of file
+#endif
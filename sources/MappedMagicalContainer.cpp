@@ -0,0 +1,10 @@
+#include "MappedMagicalContainer.hpp"
+#include "MappedStore.hpp"
+
+using namespace std;
+
+
+namespace ariel{
+MappedMagicalContainer::MappedMagicalContainer(const string &path)
+    : MagicalContainer(make_shared<MappedStore>(path)) {}
+}
@@ -0,0 +1,29 @@
+#ifndef MAPPED_MAGICAL_CONTAINER_HPP
+#define MAPPED_MAGICAL_CONTAINER_HPP
+
+#include "MagicalContainer.hpp"
+
+#include <string>
+
+namespace ariel
+{
+    /*
+     * @brief A read-only container traversing a memory-mapped container file in place.
+     *
+     * The file must have been written with ContainerFile::save(container, path, ContainerFile::Encoding::Raw).
+     * All three iterators work as on any container; adding or removing elements throws std::runtime_error.
+     */
+    class MappedMagicalContainer : public MagicalContainer
+    {
+    public:
+        /*
+         * @brief Maps a container file.
+         *
+         * @param path The file.
+         * @throws std::runtime_error If the file cannot be mapped or is not a valid Raw container file.
+         */
+        explicit MappedMagicalContainer(const std::string& path);
+    };
+}
+
+#endif
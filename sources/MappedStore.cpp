@@ -0,0 +1,174 @@
+#include "MappedStore.hpp"
+#include "ContainerFile.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+namespace ariel{
+FileMapping::FileMapping(const string &path)
+{
+    int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0)
+    {
+        throw runtime_error("Error: cannot open " + path);
+    }
+
+    struct stat status{};
+    if (fstat(descriptor, &status) != 0)
+    {
+        close(descriptor);
+        throw runtime_error("Error: cannot read " + path);
+    }
+
+    size = static_cast<size_t>(status.st_size);
+    if (size > 0)
+    {
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+        if (mapped == MAP_FAILED)
+        {
+            close(descriptor);
+            throw runtime_error("Error: cannot map " + path);
+        }
+        data = static_cast<const uint8_t *>(mapped);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(descriptor);
+}
+
+FileMapping::~FileMapping()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(data), size);
+    }
+}
+
+span<const uint8_t> FileMapping::bytes() const
+{
+    return {data, size};
+}
+
+MappedStore::MappedStore(const string &path)
+    : mapping(make_shared<FileMapping>(path))
+{
+    static_assert(endian::native == endian::little, "Raw container files are read in place as little-endian");
+
+    span<const uint8_t> bytes = mapping->bytes();
+    ContainerFile::Header header = ContainerFile::parseHeader(bytes);
+    if (header.encoding != ContainerFile::Encoding::Raw)
+    {
+        throw runtime_error("Error: only Raw container files can be mapped");
+    }
+
+    // The header is 32 bytes and the mapping page-aligned, so both arrays are 4-byte aligned
+    elementCount = header.count;
+    primeCount = header.primeCount;
+    values = reinterpret_cast<const int32_t *>(bytes.data() + ContainerFile::HeaderSize);
+    primePositions = reinterpret_cast<const uint32_t *>(bytes.data() + ContainerFile::HeaderSize + header.valueBytes);
+
+    // Every lookup binary-searches the values and at() follows the prime positions unchecked, so a corrupt
+    // file is rejected here rather than answering wrongly later
+    for (size_t position = 1; position < elementCount; ++position)
+    {
+        if (values[position] <= values[position - 1])
+        {
+            throw runtime_error("Error: corrupt container file");
+        }
+    }
+
+    for (size_t prime = 0; prime < primeCount; ++prime)
+    {
+        if (primePositions[prime] >= elementCount || (prime > 0 && primePositions[prime] <= primePositions[prime - 1]))
+        {
+            throw runtime_error("Error: corrupt container file");
+        }
+    }
+}
+
+shared_ptr<ElementStore> MappedStore::clone() const
+{
+    return make_shared<MappedStore>(*this);
+}
+
+StorageBackend MappedStore::backend() const
+{
+    return StorageBackend::Mapped;
+}
+
+pmr::memory_resource *MappedStore::resource() const
+{
+    return pmr::get_default_resource();
+}
+
+size_t MappedStore::size() const
+{
+    return elementCount;
+}
+
+size_t MappedStore::count(TraversalMode mode) const
+{
+    return mode == TraversalMode::Prime ? primeCount : elementCount;
+}
+
+int MappedStore::at(TraversalMode mode, size_t index) const
+{
+    if (index >= count(mode))
+    {
+        throw out_of_range("Iterator out of range");
+    }
+
+    switch (mode)
+    {
+    case TraversalMode::Ascending:
+        return values[index];
+    case TraversalMode::SideCross:
+        return values[crossToAscending(index, elementCount)];
+    case TraversalMode::Prime:
+        return values[primePositions[index]];
+    }
+
+    throw invalid_argument("Unknown traversal mode");
+}
+
+bool MappedStore::contains(int element) const
+{
+    return binary_search(values, values + elementCount, element);
+}
+
+void MappedStore::insert(int)
+{
+    throw runtime_error("Error: mapped container is read-only");
+}
+
+void MappedStore::erase(int)
+{
+    throw runtime_error("Error: mapped container is read-only");
+}
+
+void MappedStore::applyBatch(const vector<int> &, const vector<int> &)
+{
+    throw runtime_error("Error: mapped container is read-only");
+}
+
+void MappedStore::assign(span<const int>, span<const int>)
+{
+    throw runtime_error("Error: mapped container is read-only");
+}
+
+MemoryFootprint MappedStore::memoryFootprint() const
+{
+    // The arrays live in the shared page cache, not in this process's heap
+    MemoryFootprint footprint;
+    footprint.overhead = {sizeof(MappedStore) + sizeof(FileMapping), sizeof(MappedStore) + sizeof(FileMapping)};
+    return footprint;
+}
+}
@@ -0,0 +1,92 @@
+#ifndef MAPPED_STORE_HPP
+#define MAPPED_STORE_HPP
+
+#include "ElementStore.hpp"
+
+#include <string>
+#include <cstdint>
+
+namespace ariel
+{
+    /*
+     * @brief A read-only memory mapping of a whole file, unmapped when the last owner lets go.
+     */
+    class FileMapping
+    {
+    public:
+        /*
+         * @brief Maps a file for reading.
+         *
+         * @param path The file.
+         * @throws std::runtime_error If the file cannot be opened or mapped.
+         */
+        explicit FileMapping(const std::string& path);
+
+        FileMapping(const FileMapping& other) = delete;
+        FileMapping(FileMapping&& other) = delete;
+        FileMapping& operator=(const FileMapping& other) = delete;
+        FileMapping& operator=(FileMapping&& other) = delete;
+        ~FileMapping();
+
+        /*
+         * @brief Returns the mapped bytes.
+         *
+         * @return The bytes of the file.
+         */
+        std::span<const uint8_t> bytes() const;
+
+    private:
+        const uint8_t* data = nullptr;  // The first mapped byte
+        size_t size = 0;                // The number of mapped bytes
+    };
+
+    /*
+     * @brief A read-only backend that traverses a mapped Raw container file in place.
+     *
+     * The ascending order is the file's element array, the prime order its position array, and the side-cross
+     * order is computed from ascending positions. Nothing is copied to the heap, so processes mapping the same
+     * file share one page-cache copy. Copies share the mapping, and every modification throws.
+     */
+    class MappedStore : public ElementStore
+    {
+    public:
+        /*
+         * @brief Maps a container file written with the Raw encoding.
+         *
+         * The order of the values and the prime positions are checked once here, in O(n), so that lookups
+         * can binary-search the values and at() can follow the positions unchecked.
+         *
+         * @param path The file.
+         * @throws std::runtime_error If the file cannot be mapped or is not a valid Raw container file.
+         */
+        explicit MappedStore(const std::string& path);
+
+        MappedStore(const MappedStore& other) = default;
+        MappedStore(MappedStore&& other) = delete;
+        MappedStore& operator=(const MappedStore& other) = delete;
+        MappedStore& operator=(MappedStore&& other) = delete;
+        ~MappedStore() override = default;
+
+        std::shared_ptr<ElementStore> clone() const override;
+        StorageBackend backend() const override;
+        std::pmr::memory_resource* resource() const override;
+        size_t size() const override;
+        size_t count(TraversalMode mode) const override;
+        int at(TraversalMode mode, size_t index) const override;
+        bool contains(int element) const override;
+        void insert(int element) override;
+        void erase(int element) override;
+        void applyBatch(const std::vector<int>& additions, const std::vector<int>& removals) override;
+        void assign(std::span<const int> sorted, std::span<const int> primes) override;
+        MemoryFootprint memoryFootprint() const override;
+
+    private:
+        std::shared_ptr<const FileMapping> mapping;     // The mapped file, shared between copies
+        const int32_t* values = nullptr;                // The elements in ascending order, inside the mapping
+        const uint32_t* primePositions = nullptr;       // Ascending positions of the prime elements, inside the mapping
+        size_t elementCount = 0;                        // The number of elements
+        size_t primeCount = 0;                          // The number of prime elements
+    };
+}
+
+#endif
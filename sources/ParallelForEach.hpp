@@ -0,0 +1,76 @@
+#ifndef PARALLEL_FOR_EACH_HPP
+#define PARALLEL_FOR_EACH_HPP
+
+#include "MagicalContainer.hpp"
+#include "WorkStealingPool.hpp"
+
+#include <optional>
+#include <utility>
+
+namespace ariel
+{
+    /*
+     * @brief Calls a function on every element of a traversal order, spreading the positions over a thread pool.
+     *
+     * The calls run concurrently and in no particular order. The container must not be modified until the call returns.
+     *
+     * @param container The container to traverse.
+     * @param mode The traversal order whose elements are visited.
+     * @param function Called once with every element.
+     * @param pool The pool running the chunks.
+     */
+    template <typename Function>
+    void parallelForEach(const MagicalContainer& container, TraversalMode mode, Function function,
+                         WorkStealingPool& pool = WorkStealingPool::shared())
+    {
+        pool.run(container.count(mode), 0, [&](size_t, size_t begin, size_t end)
+        {
+            for (size_t index = begin; index < end; ++index)
+            {
+                function(container.at(mode, index));
+            }
+        });
+    }
+
+    /*
+     * @brief Reduces the elements of a traversal order in parallel while preserving the traversal order.
+     *
+     * Every chunk folds its elements from left to right, then the chunk results are folded in chunk order,
+     * so combine only has to be associative, not commutative.
+     *
+     * @param container The container to traverse.
+     * @param mode The traversal order whose elements are reduced.
+     * @param init The value the reduction starts from.
+     * @param map Turns an element into a value of type T.
+     * @param combine Folds two values of type T into one.
+     * @param pool The pool running the chunks.
+     * @return combine(...combine(init, map(first))..., map(last)).
+     */
+    template <typename T, typename Map, typename Combine>
+    T parallelReduce(const MagicalContainer& container, TraversalMode mode, T init, Map map, Combine combine,
+                     WorkStealingPool& pool = WorkStealingPool::shared())
+    {
+        size_t count = container.count(mode);
+        size_t grain = pool.grainSize(count);
+        std::vector<std::optional<T>> partials((count + grain - 1) / grain);
+
+        pool.run(count, grain, [&](size_t chunk, size_t begin, size_t end)
+        {
+            T partial = map(container.at(mode, begin));
+            for (size_t index = begin + 1; index < end; ++index)
+            {
+                partial = combine(std::move(partial), map(container.at(mode, index)));
+            }
+            partials[chunk] = std::move(partial);
+        });
+
+        for (std::optional<T>& partial : partials)
+        {
+            init = combine(std::move(init), std::move(*partial));
+        }
+
+        return init;
+    }
+}
+
+#endif
@@ -0,0 +1,62 @@
+#include "RangeView.hpp"
+
+#include <stdexcept>
+
+using namespace std;
+
+
+namespace ariel{
+RangeView::RangeView(MagicalContainer container, int low, int high)
+    : container(move(container))
+{
+    if (low > high)
+    {
+        return;
+    }
+
+    first = this->container.rank(TraversalMode::Ascending, low);
+    last = this->container.rank(TraversalMode::Ascending, high, true);
+    firstPrime = this->container.rank(TraversalMode::Prime, low);
+    lastPrime = this->container.rank(TraversalMode::Prime, high, true);
+}
+
+size_t RangeView::count(TraversalMode mode) const
+{
+    return mode == TraversalMode::Prime ? lastPrime - firstPrime : last - first;
+}
+
+int RangeView::at(TraversalMode mode, size_t index) const
+{
+    if (index >= count(mode))
+    {
+        throw out_of_range("Iterator out of range");
+    }
+
+    switch (mode)
+    {
+    case TraversalMode::Ascending:
+        return container.at(TraversalMode::Ascending, first + index);
+    case TraversalMode::SideCross:
+        return container.at(TraversalMode::Ascending, first + ElementStore::crossToAscending(index, last - first));
+    case TraversalMode::Prime:
+        return container.at(TraversalMode::Prime, firstPrime + index);
+    }
+
+    throw invalid_argument("Unknown traversal mode");
+}
+
+RangeView::Order RangeView::order(TraversalMode mode) const
+{
+    return Order(*this, mode);
+}
+
+RangeView::Iterator RangeView::begin(TraversalMode mode) const
+{
+    return Iterator(*this, mode, 0);
+}
+
+RangeView::Iterator RangeView::end(TraversalMode mode) const
+{
+    return Iterator(*this, mode, count(mode));
+}
+}
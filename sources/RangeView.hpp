@@ -0,0 +1,179 @@
+#ifndef RANGE_VIEW_HPP
+#define RANGE_VIEW_HPP
+
+#include "MagicalContainer.hpp"
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+namespace ariel
+{
+    /*
+     * @brief The elements of a container within a closed value range, traversable in every mode.
+     *
+     * The view holds an O(1) snapshot of the container and the bounds of the range in the ascending and prime
+     * orders, found by binary search when it is created. Counting is then O(1) and every position is one
+     * lookup in the container. The side-cross order of the view alternates between the ends of the range.
+     */
+    class RangeView
+    {
+    public:
+        /*
+         * @brief A forward iterator over one traversal order of a view.
+         */
+        class Iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = int;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const int*;
+            using reference = int;
+
+            Iterator() = default;
+
+            /*
+             * @brief Constructs an iterator at a position of a traversal order of a view.
+             *
+             * @param view The view, which must outlive the iterator.
+             * @param mode The traversal order.
+             * @param index The position.
+             */
+            Iterator(const RangeView& view, TraversalMode mode, size_t index)
+                : view(&view), mode(mode), index(index) {}
+
+            /*
+             * @brief Returns the element at the current position.
+             *
+             * @return The element.
+             * @throws std::out_of_range If the iterator is at the end.
+             */
+            int operator*() const
+            {
+                return view->at(mode, index);
+            }
+
+            /*
+             * @brief Moves to the next position.
+             *
+             * @return This iterator.
+             */
+            Iterator& operator++()
+            {
+                ++index;
+                return *this;
+            }
+
+            /*
+             * @brief Moves to the next position.
+             *
+             * @return A copy of the iterator before it moved.
+             */
+            Iterator operator++(int)
+            {
+                Iterator previous = *this;
+                ++index;
+                return previous;
+            }
+
+            /*
+             * @brief Checks whether two iterators are at the same position of the same order of the same view.
+             *
+             * @param other The other iterator.
+             * @return True if both traverse the same view in the same mode and are at the same position.
+             */
+            bool operator==(const Iterator& other) const
+            {
+                return view == other.view && mode == other.mode && index == other.index;
+            }
+
+        private:
+            const RangeView* view = nullptr;                    // The view traversed
+            TraversalMode mode = TraversalMode::Ascending;      // The traversal order
+            size_t index = 0;                                   // The current position
+        };
+
+        class Order;
+
+        /*
+         * @brief Constructs a view of the elements of a container in [low, high].
+         *
+         * @param container The contents to view, usually a snapshot.
+         * @param low The smallest value in the view.
+         * @param high The largest value in the view. A range with high < low is empty.
+         */
+        RangeView(MagicalContainer container, int low, int high);
+
+        /*
+         * @brief Returns the number of elements of the view visited by a traversal mode.
+         *
+         * @param mode The traversal mode.
+         * @return The number of positions.
+         */
+        size_t count(TraversalMode mode) const;
+
+        /*
+         * @brief Returns the element at a position of a traversal order of the view.
+         *
+         * @param mode The traversal mode.
+         * @param index The position.
+         * @return The element.
+         * @throws std::out_of_range If the index is past the end of the traversal.
+         */
+        int at(TraversalMode mode, size_t index) const;
+
+        /*
+         * @brief Returns a traversal order of the view.
+         *
+         * @param mode The traversal mode.
+         * @return The order, to iterate with begin() and end().
+         */
+        Order order(TraversalMode mode) const;
+
+        Iterator begin(TraversalMode mode) const;
+        Iterator end(TraversalMode mode) const;
+
+    private:
+        MagicalContainer container;     // The viewed contents
+        size_t first = 0;               // The first ascending position in the range
+        size_t last = 0;                // The ascending position past the range
+        size_t firstPrime = 0;          // The first prime position in the range
+        size_t lastPrime = 0;           // The prime position past the range
+    };
+
+    /*
+     * @brief One traversal order of a view, usable in a range-based for loop.
+     *
+     * The order holds its own copy of the view, which only shares the snapshot, so it stays valid when the
+     * view it came from was a temporary, as in container.range(low, high).order(mode).
+     */
+    class RangeView::Order
+    {
+    public:
+        /*
+         * @brief Constructs a traversal order of a view.
+         *
+         * @param view The view traversed.
+         * @param mode The traversal order.
+         */
+        Order(RangeView view, TraversalMode mode)
+            : view(std::move(view)), mode(mode) {}
+
+        Iterator begin() const
+        {
+            return view.begin(mode);
+        }
+
+        Iterator end() const
+        {
+            return view.end(mode);
+        }
+
+    private:
+        RangeView view;         // The view traversed
+        TraversalMode mode;     // The traversal order
+    };
+}
+
+#endif
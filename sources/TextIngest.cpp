@@ -0,0 +1,109 @@
+#include "TextIngest.hpp"
+
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+
+namespace ariel{
+static bool isSeparator(char character)
+{
+    return character == ' ' || character == '\n' || character == '\r' || character == '\t' || character == ','
+        || character == ';';
+}
+
+size_t TextIngest::load(MagicalContainer &container, istream &input, size_t chunkSize, size_t batchSize)
+{
+    if (chunkSize == 0 || batchSize == 0)
+    {
+        throw invalid_argument("Error: chunk and batch sizes must be positive");
+    }
+
+    // One spare byte past the data lets the last token of the stream end on a separator
+    vector<char> buffer(chunkSize + 1);
+    vector<int> batch;
+    batch.reserve(batchSize);
+    size_t parsed = 0, carried = 0;
+
+    while (true)
+    {
+        input.read(buffer.data() + carried, static_cast<streamsize>(buffer.size() - 1 - carried));
+        size_t filled = carried + static_cast<size_t>(input.gcount());
+        bool last = filled < buffer.size() - 1;
+        if (last)
+        {
+            buffer[filled++] = '\n';
+        }
+
+        const char *cursor = buffer.data();
+        const char *end = buffer.data() + filled;
+        while (true)
+        {
+            while (cursor != end && isSeparator(*cursor))
+            {
+                ++cursor;
+            }
+
+            // A token touching the end of a full chunk may continue in the next one
+            const char *token = cursor;
+            while (cursor != end && !isSeparator(*cursor))
+            {
+                ++cursor;
+            }
+            if (cursor == end)
+            {
+                cursor = token;
+                break;
+            }
+
+            int value = 0;
+            auto [stop, error] = from_chars(token, cursor, value);
+            if (error != errc() || stop != cursor)
+            {
+                throw runtime_error("Error: invalid integer \"" + string(token, cursor) + "\"");
+            }
+
+            batch.push_back(value);
+            ++parsed;
+            if (batch.size() == batchSize)
+            {
+                container.applyBatch(batch, {});
+                batch.clear();
+            }
+        }
+
+        carried = static_cast<size_t>(end - cursor);
+        if (last)
+        {
+            break;
+        }
+        if (carried == buffer.size() - 1)
+        {
+            throw runtime_error("Error: token longer than the read chunk");
+        }
+
+        copy(cursor, end, buffer.begin());
+    }
+
+    if (!batch.empty())
+    {
+        container.applyBatch(batch, {});
+    }
+
+    return parsed;
+}
+
+size_t TextIngest::loadFile(MagicalContainer &container, const string &path)
+{
+    ifstream file(path, ios::binary);
+    if (!file)
+    {
+        throw runtime_error("Error: cannot open " + path);
+    }
+
+    return load(container, file);
+}
+}
@@ -0,0 +1,50 @@
+#ifndef TEXT_INGEST_HPP
+#define TEXT_INGEST_HPP
+
+#include "MagicalContainer.hpp"
+
+#include <istream>
+#include <string>
+
+namespace ariel
+{
+    /*
+     * @brief Streams integers from text into a container.
+     *
+     * The input is read in large chunks into one reused buffer and parsed in place with std::from_chars.
+     * Integers may be separated by any mix of whitespace, commas and semicolons, so newline-separated lists
+     * and CSV rows both work. Parsed values are collected into fixed-size batches handed to
+     * MagicalContainer::applyBatch, so the container merges each batch at once.
+     */
+    class TextIngest
+    {
+    public:
+        static constexpr size_t ChunkSize = size_t{1} << 20;    // Bytes read from the stream at a time
+        static constexpr size_t BatchSize = size_t{1} << 16;    // Values per applyBatch call
+
+        /*
+         * @brief Adds every integer of a stream to a container.
+         *
+         * @param container The container.
+         * @param input The stream, read to its end.
+         * @param chunkSize Bytes read at a time.
+         * @param batchSize Values per batch.
+         * @return The number of integers read, duplicates included.
+         * @throws std::runtime_error If the text holds anything but integers and separators, or an integer
+         * outside the int range. Batches before the error have been applied.
+         */
+        static size_t load(MagicalContainer& container, std::istream& input, size_t chunkSize = ChunkSize, size_t batchSize = BatchSize);
+
+        /*
+         * @brief Adds every integer of a text file to a container.
+         *
+         * @param container The container.
+         * @param path The file.
+         * @return The number of integers read, duplicates included.
+         * @throws std::runtime_error If the file cannot be opened or holds anything but integers and separators.
+         */
+        static size_t loadFile(MagicalContainer& container, const std::string& path);
+    };
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include "TraversalExport.hpp"
+#include "ContainerFile.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+namespace ariel{
+static constexpr size_t MaxElementBytes = 12;   // "-2147483648" plus a newline
+
+size_t TraversalExport::write(const MagicalContainer &container, TraversalMode mode, int descriptor, ExportFormat format,
+                              size_t bufferSize)
+{
+    vector<char> buffer(max(bufferSize, size_t{16}));
+    size_t used = 0, count = container.count(mode);
+
+    auto flush = [&buffer, &used, descriptor]()
+    {
+        if (!ContainerFile::writeAll(descriptor, span(reinterpret_cast<const uint8_t *>(buffer.data()), used)))
+        {
+            throw runtime_error("Error: cannot write the export");
+        }
+        used = 0;
+    };
+
+    for (size_t position = 0; position < count; ++position)
+    {
+        if (buffer.size() - used < MaxElementBytes)
+        {
+            flush();
+        }
+
+        int element = container.at(mode, position);
+        if (format == ExportFormat::Text)
+        {
+            char *end = to_chars(buffer.data() + used, buffer.data() + buffer.size(), element).ptr;
+            *end++ = '\n';
+            used = static_cast<size_t>(end - buffer.data());
+        }
+        else
+        {
+            auto bits = static_cast<uint32_t>(element);
+            for (size_t byte = 0; byte < 4; ++byte)
+            {
+                buffer[used++] = static_cast<char>(bits >> (8 * byte));
+            }
+        }
+    }
+
+    flush();
+    return count;
+}
+
+size_t TraversalExport::write(const MagicalContainer &container, TraversalMode mode, const string &path, ExportFormat format)
+{
+    int descriptor = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (descriptor < 0)
+    {
+        throw runtime_error("Error: cannot write " + path);
+    }
+
+    size_t count = 0;
+    try
+    {
+        count = write(container, mode, descriptor, format);
+    }
+    catch (const runtime_error &)
+    {
+        close(descriptor);
+        throw runtime_error("Error: cannot write " + path);
+    }
+    catch (...)
+    {
+        // Anything else, such as a failed buffer allocation, still must not leak the descriptor
+        close(descriptor);
+        throw;
+    }
+
+    if (close(descriptor) != 0)
+    {
+        throw runtime_error("Error: cannot write " + path);
+    }
+
+    return count;
+}
+}
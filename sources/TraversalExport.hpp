@@ -0,0 +1,51 @@
+#ifndef TRAVERSAL_EXPORT_HPP
+#define TRAVERSAL_EXPORT_HPP
+
+#include "MagicalContainer.hpp"
+
+#include <string>
+
+namespace ariel
+{
+    /*
+     * @brief Writes a traversal order of a container to a file descriptor in large blocks.
+     *
+     * Elements are formatted into one reused buffer, as text with std::to_chars or as little-endian binary,
+     * and the buffer is written whenever it fills up, so an export costs one write call per buffer rather
+     * than one per element.
+     */
+    class TraversalExport
+    {
+    public:
+        static constexpr size_t BufferSize = size_t{1} << 18;   // Bytes formatted before each write
+
+        /*
+         * @brief Writes a traversal order to a file descriptor.
+         *
+         * @param container The container.
+         * @param mode The traversal order.
+         * @param descriptor The file descriptor, left open.
+         * @param format The text or binary format.
+         * @param bufferSize Bytes formatted before each write, at least 16.
+         * @return The number of elements written.
+         * @throws std::runtime_error If a write fails.
+         */
+        static size_t write(const MagicalContainer& container, TraversalMode mode, int descriptor,
+                            ExportFormat format = ExportFormat::Text, size_t bufferSize = BufferSize);
+
+        /*
+         * @brief Writes a traversal order to a file, replacing it.
+         *
+         * @param container The container.
+         * @param mode The traversal order.
+         * @param path The file.
+         * @param format The text or binary format.
+         * @return The number of elements written.
+         * @throws std::runtime_error If the file cannot be written.
+         */
+        static size_t write(const MagicalContainer& container, TraversalMode mode, const std::string& path,
+                            ExportFormat format = ExportFormat::Text);
+    };
+}
+
+#endif
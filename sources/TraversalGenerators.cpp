@@ -0,0 +1,71 @@
+#include "TraversalGenerators.hpp"
+
+#include <vector>
+
+using namespace std;
+
+
+namespace ariel{
+Generator<int> traverse(MagicalContainer container, TraversalMode mode)
+{
+    for (size_t index = 0; index < container.count(mode); ++index)
+    {
+        co_yield container.at(mode, index);
+    }
+}
+
+Generator<int> ascending(MagicalContainer container)
+{
+    return traverse(move(container), TraversalMode::Ascending);
+}
+
+Generator<int> sideCross(MagicalContainer container)
+{
+    return traverse(move(container), TraversalMode::SideCross);
+}
+
+Generator<int> primes(MagicalContainer container)
+{
+    return traverse(move(container), TraversalMode::Prime);
+}
+
+Generator<int> filtered(MagicalContainer container, TraversalMode mode, function<bool(int)> predicate)
+{
+    for (size_t index = 0; index < container.count(mode); ++index)
+    {
+        int element = container.at(mode, index);
+
+        if (predicate(element))
+        {
+            co_yield element;
+        }
+    }
+}
+
+Generator<span<const int>> chunked(MagicalContainer container, TraversalMode mode, size_t chunkSize)
+{
+    if (chunkSize == 0)
+    {
+        throw invalid_argument("Chunk size must be positive");
+    }
+
+    vector<int> chunk;
+    chunk.reserve(min(chunkSize, container.count(mode)));
+
+    for (size_t index = 0; index < container.count(mode); ++index)
+    {
+        chunk.push_back(container.at(mode, index));
+
+        if (chunk.size() == chunkSize)
+        {
+            co_yield span<const int>(chunk);
+            chunk.clear();
+        }
+    }
+
+    if (!chunk.empty())
+    {
+        co_yield span<const int>(chunk);
+    }
+}
+}
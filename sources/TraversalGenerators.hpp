@@ -0,0 +1,76 @@
+#ifndef TRAVERSAL_GENERATORS_HPP
+#define TRAVERSAL_GENERATORS_HPP
+
+#include "MagicalContainer.hpp"
+#include "Generator.hpp"
+
+#include <functional>
+#include <span>
+
+namespace ariel
+{
+    /*
+     * The generators take the container by value, which is an O(1) snapshot: the values they produce
+     * come from the contents at the time of the call, even if the original container changes while
+     * the generator is suspended.
+     */
+
+    /*
+     * @brief Lazily produces the elements of a traversal order.
+     *
+     * @param container The contents to traverse.
+     * @param mode The traversal order.
+     * @return A generator of the elements in that order.
+     */
+    Generator<int> traverse(MagicalContainer container, TraversalMode mode);
+
+    /*
+     * @brief Lazily produces the elements in ascending order.
+     *
+     * @param container The contents to traverse.
+     * @return A generator of the elements in ascending order.
+     */
+    Generator<int> ascending(MagicalContainer container);
+
+    /*
+     * @brief Lazily produces the elements in side-cross order.
+     *
+     * @param container The contents to traverse.
+     * @return A generator of the elements in side-cross order.
+     */
+    Generator<int> sideCross(MagicalContainer container);
+
+    /*
+     * @brief Lazily produces the prime elements in ascending order.
+     *
+     * @param container The contents to traverse.
+     * @return A generator of the prime elements.
+     */
+    Generator<int> primes(MagicalContainer container);
+
+    /*
+     * @brief Lazily produces the elements of a traversal order that satisfy a predicate.
+     *
+     * @param container The contents to traverse.
+     * @param mode The traversal order.
+     * @param predicate Called on every element; only the elements it accepts are produced.
+     * @return A generator of the accepted elements, in traversal order.
+     */
+    Generator<int> filtered(MagicalContainer container, TraversalMode mode, std::function<bool(int)> predicate);
+
+    /*
+     * @brief Lazily produces the elements of a traversal order in chunks.
+     *
+     * Every span stays valid until the generator is advanced. All chunks hold chunkSize elements except
+     * possibly the last one.
+     *
+     * @param container The contents to traverse.
+     * @param mode The traversal order.
+     * @param chunkSize The number of elements per chunk.
+     * @return A generator of consecutive chunks of the traversal.
+     * @throws std::invalid_argument When iteration starts, if chunkSize is 0.
+     */
+    Generator<std::span<const int>> chunked(MagicalContainer container, TraversalMode mode, size_t chunkSize);
+}
+
+#endif
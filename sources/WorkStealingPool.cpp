@@ -0,0 +1,201 @@
+#include "WorkStealingPool.hpp"
+
+using namespace std;
+
+
+namespace ariel{
+// The pool whose chunks the current thread is running, if any
+static thread_local const WorkStealingPool *participating = nullptr;
+
+WorkStealingPool::WorkStealingPool(size_t threads)
+{
+    if (threads == 0)
+    {
+        threads = max<size_t>(1, thread::hardware_concurrency());
+    }
+
+    queues.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+    {
+        queues.push_back(make_unique<Queue>());
+    }
+
+    workers.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i)
+    {
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+
+    for (thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::run(size_t count, size_t grain, const Task &work)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    if (grain == 0)
+    {
+        grain = grainSize(count);
+    }
+
+    size_t chunks = (count + grain - 1) / grain;
+
+    // Every participant is already busy with the outer run, so a nested run executes on the calling thread
+    if (participating == this)
+    {
+        for (size_t number = 0; number < chunks; ++number)
+        {
+            work(number, number * grain, min(count, (number + 1) * grain));
+        }
+        return;
+    }
+
+    lock_guard<mutex> runLock(runMutex);
+
+    {
+        lock_guard<mutex> lock(stateMutex);
+        task = &work;
+        error = nullptr;
+        remaining = chunks;
+    }
+
+    // Hand every participant a contiguous run of chunks, stealing evens out the rest
+    for (size_t number = 0; number < chunks; ++number)
+    {
+        Queue &queue = *queues[number * queues.size() / chunks];
+        lock_guard<mutex> lock(queue.mutex);
+        queue.chunks.push_back({number, number * grain, min(count, (number + 1) * grain)});
+    }
+
+    {
+        lock_guard<mutex> lock(stateMutex);
+        ++generation;
+    }
+    wakeUp.notify_all();
+
+    const WorkStealingPool *outer = participating;
+    participating = this;
+    drain(0);
+    participating = outer;
+
+    unique_lock<mutex> lock(stateMutex);
+    finished.wait(lock, [this] { return remaining == 0; });
+    task = nullptr;
+
+    if (error)
+    {
+        exception_ptr failure = error;
+        error = nullptr;
+        rethrow_exception(failure);
+    }
+}
+
+size_t WorkStealingPool::grainSize(size_t count) const
+{
+    return max<size_t>(1, count / (threads() * 8));
+}
+
+size_t WorkStealingPool::threads() const
+{
+    return queues.size();
+}
+
+WorkStealingPool &WorkStealingPool::shared()
+{
+    static WorkStealingPool pool;
+    return pool;
+}
+
+bool WorkStealingPool::takeChunk(size_t self, Chunk &chunk)
+{
+    {
+        Queue &own = *queues[self];
+        lock_guard<mutex> lock(own.mutex);
+        if (!own.chunks.empty())
+        {
+            chunk = own.chunks.back();
+            own.chunks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < queues.size(); ++offset)
+    {
+        Queue &victim = *queues[(self + offset) % queues.size()];
+        lock_guard<mutex> lock(victim.mutex);
+        if (!victim.chunks.empty())
+        {
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingPool::drain(size_t self)
+{
+    Chunk chunk{};
+
+    while (takeChunk(self, chunk))
+    {
+        try
+        {
+            (*task)(chunk.number, chunk.begin, chunk.end);
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(stateMutex);
+            if (!error)
+            {
+                error = current_exception();
+            }
+        }
+
+        if (remaining.fetch_sub(1) == 1)
+        {
+            lock_guard<mutex> lock(stateMutex);
+            finished.notify_all();
+        }
+    }
+}
+
+void WorkStealingPool::workerLoop(size_t self)
+{
+    size_t seen = 0;
+    participating = this;
+
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(stateMutex);
+            wakeUp.wait(lock, [this, seen] { return stopping || generation != seen; });
+
+            if (stopping)
+            {
+                return;
+            }
+
+            seen = generation;
+        }
+
+        drain(self);
+    }
+}
+}
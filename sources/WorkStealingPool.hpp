@@ -0,0 +1,134 @@
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+
+namespace ariel
+{
+    /*
+     * @brief A fixed-size thread pool that splits an index space into chunks and balances them by work stealing.
+     *
+     * Every participant (the worker threads and the calling thread) owns a deque of chunks. A participant
+     * takes chunks from the back of its own deque and, once it runs dry, steals from the front of the others.
+     */
+    class WorkStealingPool
+    {
+    public:
+        /*
+         * @brief The work handed to run(): the chunk number and the half-open index range [begin, end).
+         */
+        using Task = std::function<void(size_t chunk, size_t begin, size_t end)>;
+
+        /*
+         * @brief Constructs a pool and starts its worker threads.
+         *
+         * @param threads Number of participants including the caller; 0 uses the hardware concurrency.
+         */
+        explicit WorkStealingPool(size_t threads = 0);
+
+        /*
+         * @brief Stops and joins the worker threads.
+         */
+        ~WorkStealingPool();
+
+        WorkStealingPool(const WorkStealingPool& other) = delete;
+        WorkStealingPool(WorkStealingPool&& other) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool& other) = delete;
+        WorkStealingPool& operator=(WorkStealingPool&& other) = delete;
+
+        /*
+         * @brief Runs a task over the index range [0, count) and waits for it to finish.
+         *
+         * The first exception thrown by the task is rethrown here once every chunk has completed.
+         * A run started from inside a task of this pool executes its chunks in order on the calling thread,
+         * since every participant is already busy; its exceptions propagate right away.
+         *
+         * @param count Size of the index space.
+         * @param grain Indexes per chunk; 0 picks grainSize(count).
+         * @param task The work to run for every chunk.
+         */
+        void run(size_t count, size_t grain, const Task& task);
+
+        /*
+         * @brief Returns the default number of indexes per chunk for an index space.
+         *
+         * @param count Size of the index space.
+         * @return The chunk size, at least 1.
+         */
+        size_t grainSize(size_t count) const;
+
+        /*
+         * @brief Returns the number of participants, including the calling thread.
+         *
+         * @return The number of participants.
+         */
+        size_t threads() const;
+
+        /*
+         * @brief Returns a process-wide pool sized to the hardware concurrency.
+         *
+         * @return A reference to the shared pool.
+         */
+        static WorkStealingPool& shared();
+
+    private:
+        struct Chunk
+        {
+            size_t number;      // Position of the chunk in the index space
+            size_t begin;       // First index of the chunk
+            size_t end;         // One past the last index of the chunk
+        };
+
+        struct Queue
+        {
+            std::mutex mutex;           // Guards the chunks of this participant
+            std::deque<Chunk> chunks;   // Chunks owned by this participant
+        };
+
+        std::vector<std::unique_ptr<Queue>> queues;    // One queue per participant, the caller uses queues[0]
+        std::vector<std::thread> workers;              // The worker threads
+        std::mutex runMutex;                           // Serializes concurrent calls to run()
+        std::mutex stateMutex;                         // Guards the fields below
+        std::condition_variable wakeUp;                // Signals workers that a run started or the pool stops
+        std::condition_variable finished;              // Signals the caller that the last chunk completed
+        const Task* task = nullptr;                    // The task of the current run
+        size_t generation = 0;                         // Incremented on every run
+        std::atomic<size_t> remaining{0};              // Chunks of the current run not yet completed
+        std::exception_ptr error;                      // First exception thrown by the current run
+        bool stopping = false;                         // Set when the pool is destroyed
+
+        /*
+         * @brief Takes a chunk from the participant's own queue, or steals one from another participant.
+         *
+         * @param self The participant looking for work.
+         * @param chunk Receives the chunk.
+         * @return True if a chunk was found, false if every queue is empty.
+         */
+        bool takeChunk(size_t self, Chunk& chunk);
+
+        /*
+         * @brief Executes chunks until every queue is empty.
+         *
+         * @param self The participant executing the chunks.
+         */
+        void drain(size_t self);
+
+        /*
+         * @brief The loop of a worker thread.
+         *
+         * @param self The participant number of the worker.
+         */
+        void workerLoop(size_t self);
+    };
+}
+
+#endif
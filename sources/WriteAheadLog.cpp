@@ -0,0 +1,268 @@
+#include "WriteAheadLog.hpp"
+#include "ContainerFile.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+namespace ariel{
+static constexpr size_t ReplayBatch = size_t{1} << 16;  // Distinct elements collected before a replayed batch is applied
+
+/*
+ * @brief Stores an unsigned integer in little-endian byte order.
+ */
+static void storeFixed(uint8_t *bytes, uint32_t value, size_t width)
+{
+    for (size_t byte = 0; byte < width; ++byte)
+    {
+        bytes[byte] = static_cast<uint8_t>(value >> (8 * byte));
+    }
+}
+
+/*
+ * @brief Loads an unsigned integer in little-endian byte order.
+ */
+static uint32_t loadFixed(const uint8_t *bytes, size_t width)
+{
+    uint32_t value = 0;
+    for (size_t byte = 0; byte < width; ++byte)
+    {
+        value |= uint32_t{bytes[byte]} << (8 * byte);
+    }
+    return value;
+}
+
+/*
+ * @brief Computes the 32-bit FNV-1a hash of some bytes.
+ */
+static uint32_t checksum(span<const uint8_t> bytes)
+{
+    uint32_t hash = 2166136261U;
+    for (uint8_t byte : bytes)
+    {
+        hash = (hash ^ byte) * 16777619U;
+    }
+    return hash;
+}
+
+/*
+ * @brief Applies the last operation collected for every element as one batch.
+ */
+static void applyLatest(MagicalContainer &container, unordered_map<int, bool> &latest)
+{
+    vector<int> additions, removals;
+    for (const auto &[element, addition] : latest)
+    {
+        (addition ? additions : removals).push_back(element);
+    }
+
+    container.applyBatch(additions, removals);
+    latest.clear();
+}
+
+WriteAheadLog::WriteAheadLog(MagicalContainer &container, const string &path, SyncPolicy sync, size_t groupSize)
+    : container(container), path(path), sync(sync), groupSize(max(groupSize, size_t{1}))
+{
+    descriptor = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (descriptor < 0)
+    {
+        throw runtime_error("Error: cannot open " + path);
+    }
+
+    try
+    {
+        vector<uint8_t> bytes = ContainerFile::readFile(path);
+        size_t replayed = 0;
+        size_t valid = replay(container, bytes, replayed);
+
+        if (valid < bytes.size() && ftruncate(descriptor, static_cast<off_t>(valid)) != 0)
+        {
+            throw runtime_error("Error: cannot truncate " + path);
+        }
+
+        if (valid == 0)
+        {
+            uint8_t header[HeaderSize] = {};
+            copy(begin(Magic), end(Magic), header);
+            storeFixed(header + 4, Version, 2);
+            if (!ContainerFile::writeAll(descriptor, header))
+            {
+                throw runtime_error("Error: cannot write " + path);
+            }
+        }
+
+        committed = max(valid, HeaderSize);
+    }
+    catch (...)
+    {
+        close(descriptor);
+        throw;
+    }
+
+    group.reserve(GroupHeaderSize + RecordSize * this->groupSize);
+    group.resize(GroupHeaderSize);
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+    // A destructor cannot report a failed write; callers wanting to know call commit() first
+    try
+    {
+        commit();
+    }
+    catch (...)
+    {
+    }
+
+    close(descriptor);
+}
+
+void WriteAheadLog::addElement(int element)
+{
+    requireUsable();
+    container.addElement(element);
+    append(element, true);
+}
+
+void WriteAheadLog::removeElement(int element)
+{
+    requireUsable();
+    container.removeElement(element);
+    append(element, false);
+}
+
+void WriteAheadLog::commit()
+{
+    requireUsable();
+    if (records == 0)
+    {
+        return;
+    }
+
+    span<const uint8_t> body(group.data() + GroupHeaderSize, group.size() - GroupHeaderSize);
+    storeFixed(group.data(), static_cast<uint32_t>(records), 4);
+    storeFixed(group.data() + 4, checksum(body), 4);
+
+    // A group cut short must not stay in front of the next one, so the file goes back to its last complete
+    // group and the records stay pending for another commit(). If even that fails, later groups would land
+    // behind the torn one and never be replayed, so the log refuses any further writes
+    bool written = ContainerFile::writeAll(descriptor, group);
+    if (!written || (sync == SyncPolicy::Commit && fdatasync(descriptor) != 0))
+    {
+        string failure = (written ? "Error: cannot sync " : "Error: cannot write ") + path;
+        if (ftruncate(descriptor, static_cast<off_t>(committed)) != 0)
+        {
+            broken = true;
+            throw runtime_error(failure + ", and cannot truncate it back; the log is unusable");
+        }
+        throw runtime_error(failure);
+    }
+
+    committed += group.size();
+    group.resize(GroupHeaderSize);
+    records = 0;
+}
+
+void WriteAheadLog::requireUsable() const
+{
+    if (broken)
+    {
+        throw runtime_error("Error: " + path + " holds a torn group and is unusable");
+    }
+}
+
+size_t WriteAheadLog::pending() const
+{
+    return records;
+}
+
+size_t WriteAheadLog::replay(MagicalContainer &container, const string &path)
+{
+    if (!filesystem::exists(path))
+    {
+        return 0;
+    }
+
+    size_t records = 0;
+    replay(container, ContainerFile::readFile(path), records);
+    return records;
+}
+
+void WriteAheadLog::append(int element, bool addition)
+{
+    uint8_t record[RecordSize];
+    record[0] = addition ? 1 : 0;
+    storeFixed(record + 1, static_cast<uint32_t>(element), 4);
+    group.insert(group.end(), begin(record), end(record));
+
+    if (++records == groupSize)
+    {
+        commit();
+    }
+}
+
+size_t WriteAheadLog::replay(MagicalContainer &container, span<const uint8_t> bytes, size_t &records)
+{
+    records = 0;
+
+    // A file cut short while its header was written holds no records
+    if (bytes.size() < HeaderSize)
+    {
+        return 0;
+    }
+
+    if (!equal(begin(Magic), end(Magic), bytes.begin()))
+    {
+        throw runtime_error("Error: not a write-ahead log");
+    }
+
+    if (loadFixed(bytes.data() + 4, 2) > Version)
+    {
+        throw runtime_error("Error: unsupported write-ahead log version");
+    }
+
+    // Only the last operation on every element matters, so the records are applied in bulk
+    unordered_map<int, bool> latest;
+    size_t offset = HeaderSize;
+    while (bytes.size() - offset >= GroupHeaderSize)
+    {
+        size_t count = loadFixed(bytes.data() + offset, 4);
+        if (count == 0 || count > (bytes.size() - offset - GroupHeaderSize) / RecordSize)
+        {
+            break;
+        }
+
+        span<const uint8_t> body = bytes.subspan(offset + GroupHeaderSize, count * RecordSize);
+        if (checksum(body) != loadFixed(bytes.data() + offset + 4, 4))
+        {
+            break;
+        }
+
+        for (size_t record = 0; record < count; ++record)
+        {
+            const uint8_t *data = body.data() + record * RecordSize;
+            latest[static_cast<int>(loadFixed(data + 1, 4))] = data[0] != 0;
+            if (latest.size() == ReplayBatch)
+            {
+                applyLatest(container, latest);
+            }
+        }
+
+        records += count;
+        offset += GroupHeaderSize + body.size();
+    }
+
+    if (!latest.empty())
+    {
+        applyLatest(container, latest);
+    }
+
+    return offset;
+}
+}
@@ -0,0 +1,148 @@
+#ifndef WRITE_AHEAD_LOG_HPP
+#define WRITE_AHEAD_LOG_HPP
+
+#include "MagicalContainer.hpp"
+
+#include <string>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+namespace ariel
+{
+    /*
+     * @brief An append-only log of the additions and removals of a container.
+     *
+     * Operations go through the log, which applies them to the container and buffers a record of each. A
+     * group of records is written with a single write call, and optionally made durable with fdatasync, when
+     * commit() is called or the group is full. Opening a log replays the records already in the file.
+     *
+     * A file is an 8-byte header, magic "MGCW" | version (u16) | reserved (u16), followed by groups:
+     *   record count (u32) | FNV-1a checksum of the records (u32) | records
+     * Every record is one operation byte (1 to add, 0 to remove) and the little-endian element (i32). A group
+     * cut short by a crash fails its checksum and is ignored, along with anything after it.
+     */
+    class WriteAheadLog
+    {
+    public:
+        static constexpr char Magic[4] = {'M', 'G', 'C', 'W'};    // The first bytes of every log
+        static constexpr uint16_t Version = 1;                     // The newest version this code reads and writes
+        static constexpr size_t HeaderSize = 8;                    // Bytes before the first group
+        static constexpr size_t GroupHeaderSize = 8;               // Bytes before the records of a group
+        static constexpr size_t RecordSize = 5;                    // Bytes per record
+        static constexpr size_t GroupSize = 4096;                  // Records per group by default
+
+        /*
+         * @brief When a written group is flushed to the disk.
+         */
+        enum class SyncPolicy
+        {
+            None,       // Never; a group survives a crash of the process but not of the machine
+            Commit      // After every group, with fdatasync
+        };
+
+        /*
+         * @brief Opens or creates a log for a container and replays the records already in it.
+         *
+         * A torn group at the end of the file is cut off, so new groups follow the last complete one.
+         *
+         * @param container The container the operations are applied to. It must outlive the log.
+         * @param path The file.
+         * @param sync When written groups are flushed to the disk.
+         * @param groupSize Records buffered before a group is written without a call to commit().
+         * @throws std::runtime_error If the file cannot be opened or is not a log.
+         */
+        WriteAheadLog(MagicalContainer& container, const std::string& path, SyncPolicy sync = SyncPolicy::Commit,
+                      size_t groupSize = GroupSize);
+
+        /*
+         * @brief Writes the buffered records and closes the file.
+         */
+        ~WriteAheadLog();
+
+        WriteAheadLog(const WriteAheadLog& other) = delete;
+        WriteAheadLog(WriteAheadLog&& other) = delete;
+        WriteAheadLog& operator=(const WriteAheadLog& other) = delete;
+        WriteAheadLog& operator=(WriteAheadLog&& other) = delete;
+
+        /*
+         * @brief Adds an element to the container and records the addition.
+         *
+         * @param element The element to add.
+         * @throws std::runtime_error If the record completes a group that cannot be written, or the log is
+         * unusable.
+         */
+        void addElement(int element);
+
+        /*
+         * @brief Removes an element from the container and records the removal.
+         *
+         * @param element The element to remove.
+         * @throws std::runtime_error If the record completes a group that cannot be written, or the log is
+         * unusable.
+         */
+        void removeElement(int element);
+
+        /*
+         * @brief Writes the buffered records as one group, synced according to the policy.
+         *
+         * @throws std::runtime_error If the group cannot be written or synced. The file is cut back to its
+         * last complete group and the records stay buffered. If the file cannot be cut back, the log is
+         * unusable and every later call throws.
+         */
+        void commit();
+
+        /*
+         * @brief Gets the number of records not written yet.
+         *
+         * @return The number of buffered records.
+         */
+        size_t pending() const;
+
+        /*
+         * @brief Applies the records of a log to a container, in bulk.
+         *
+         * @param container The container.
+         * @param path The file. A missing or empty file holds no records.
+         * @return The number of records applied.
+         * @throws std::runtime_error If the file is not a log.
+         */
+        static size_t replay(MagicalContainer& container, const std::string& path);
+
+    private:
+        MagicalContainer& container;    // The container the operations are applied to
+        std::string path;               // The file
+        int descriptor = -1;            // The file, opened for appending
+        SyncPolicy sync;                // When written groups are flushed to the disk
+        size_t groupSize;               // Records per group
+        std::vector<uint8_t> group;     // The group being filled, header included
+        size_t records = 0;             // Records in the group being filled
+        size_t committed = 0;           // Length of the complete groups in the file, header included
+        bool broken = false;            // Set when a torn group could not be cut off; every later write throws
+
+        /*
+         * @brief Buffers a record, writing the group if it is full.
+         */
+        void append(int element, bool addition);
+
+        /*
+         * @brief Refuses to go on with a log whose file may hold a torn group.
+         *
+         * @throws std::runtime_error If a failed commit could not truncate the file back.
+         */
+        void requireUsable() const;
+
+        /*
+         * @brief Applies the complete groups of a log to a container.
+         *
+         * @param container The container.
+         * @param bytes The bytes of the file.
+         * @param records Receives the number of records applied.
+         * @return The length of the complete groups, header included.
+         * @throws std::runtime_error If the bytes do not start with a log header.
+         */
+        static size_t replay(MagicalContainer& container, std::span<const uint8_t> bytes, size_t& records);
+    };
+}
+
+#endif